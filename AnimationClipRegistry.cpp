@@ -0,0 +1,87 @@
+#include "AnimationClipRegistry.h"
+#include <thread>
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationClipRegistry class. Reclamation works like userspace RCU with two sets of counters:
+// a lookup counts itself in its thread's counter of the current phase before loading the snapshot, and
+// a change flips the phase and waits for every counter of the old phase to drain, twice, so every
+// lookup that may have loaded the old snapshot has finished before it is freed. A lookup the change
+// missed in a counter it already saw at zero counted itself after that check, so it loads the new
+// snapshot. Lookups only increment and decrement a counter, so they finish in a bounded number of steps
+// however long a change takes; all accesses are sequentially consistent, which the argument relies on.
+
+namespace {
+    std::atomic<int> g_readerThreads{0};                                  // Threads that looked up names so far
+    thread_local const int t_readerThread = g_readerThreads.fetch_add(1); // Picks this thread's reader counters
+}
+
+AnimationClipRegistry::AnimationClipRegistry() : m_current(new Snapshot()) {}
+
+AnimationClipRegistry::~AnimationClipRegistry() {
+    delete m_current.load();
+}
+
+int AnimationClipRegistry::find(std::string_view animation) const {
+    // Count the lookup in the current phase, so a change waits for it before freeing what it reads
+    ReaderCount &readers = m_readers[m_phase.load() & 1][t_readerThread % ReaderShards];
+    readers.count.fetch_add(1);
+
+    // Look the name up in the current snapshot
+    const Snapshot &snapshot = *m_current.load();
+    auto clipId = snapshot.find(animation);
+    const int result = clipId != snapshot.end() ? clipId->second : -1;
+
+    readers.count.fetch_sub(1);
+    return result;
+}
+
+void AnimationClipRegistry::insert(const std::string &animation, int clipId) {
+    // Copy the current snapshot with the animation added or changed
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Snapshot *snapshot = new Snapshot(*m_current.load());
+    (*snapshot)[animation] = clipId;
+    publish(snapshot);
+}
+
+void AnimationClipRegistry::insert(const std::vector<std::pair<std::string, int>> &animations) {
+    // Copy the current snapshot once with every animation added or changed
+    if (animations.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Snapshot *snapshot = new Snapshot(*m_current.load());
+    for (const std::pair<std::string, int> &animation: animations) {
+        (*snapshot)[animation.first] = animation.second;
+    }
+    publish(snapshot);
+}
+
+void AnimationClipRegistry::erase(const std::string &animation) {
+    // Copy the current snapshot without the animation, unless it is not there at all
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    const Snapshot *current = m_current.load();
+    if (current->find(animation) == current->end()) {
+        return;
+    }
+    Snapshot *snapshot = new Snapshot(*current);
+    snapshot->erase(animation);
+    publish(snapshot);
+}
+
+void AnimationClipRegistry::publish(Snapshot *snapshot) {
+    // New lookups read the new snapshot from here on
+    const Snapshot *old = m_current.exchange(snapshot);
+
+    // Wait for the lookups of both phases to drain. Flipping the phase first sends new lookups to the other
+    // counter, so the one waited for only drains; a lookup that read the phase before a flip but counts itself
+    // after the wait has seen zero loads the snapshot after the exchange above, so it never reads the old one.
+    for (int flip = 0; flip < 2; ++flip) {
+        const unsigned phase = m_phase.fetch_add(1);
+        for (const ReaderCount &readers: m_readers[phase & 1]) {
+            while (readers.count.load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    delete old;
+}
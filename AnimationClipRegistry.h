@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// This header file defines the AnimationClipRegistry class, which maps animation names to clip ids
+// for an AnimationContext. The class provides functions to:
+// - Look up the clip id of an animation from any thread, without locks and without waiting.
+// - Add, replace and remove animations while other threads keep looking them up, one or a chunk at a time.
+// Lookups read an immutable snapshot of the names. Every change copies the current snapshot, edits the
+// copy and publishes it with one atomic store, then frees the old snapshot once no lookup can still be
+// reading it, so a level can be streamed in while the updating thread resolves names. Lookups count
+// themselves in one of several counters picked by thread, so parallel lookups do not share a cache line.
+
+class AnimationClipRegistry {
+public:
+    // Constructor and destructor; the registry starts empty and cannot be copied
+    AnimationClipRegistry();
+    AnimationClipRegistry(const AnimationClipRegistry &) = delete;
+    AnimationClipRegistry &operator=(const AnimationClipRegistry &) = delete;
+    ~AnimationClipRegistry();
+
+    // Function to look up the clip id of an animation from any thread (returns -1 if not found). The name is
+    // compared in place, so looking up a string literal does not build a std::string.
+    int find(std::string_view animation) const;
+
+    // Function to add an animation or give it another clip id
+    void insert(const std::string &animation, int clipId);
+
+    // Function to add a chunk of animations or give them other clip ids, with one copy of the snapshot
+    void insert(const std::vector<std::pair<std::string, int>> &animations);
+
+    // Function to remove an animation (does nothing if it was never added)
+    void erase(const std::string &animation);
+
+private:
+    using Snapshot = std::map<std::string, int, std::less<>>;
+
+    // Counter of lookups in progress that started in one phase on some of the threads, alone on its cache line
+    struct ReaderCount {
+        alignas(64) std::atomic<int> count{0};
+    };
+    static const int ReaderShards = 16; // Counters of each phase, picked by thread
+
+    // Function to make a snapshot current and free the one it replaces once no lookup reads it
+    void publish(Snapshot *snapshot);
+
+    std::mutex m_writeMutex;                // Serialises changes, never taken by lookups
+    std::atomic<const Snapshot *> m_current; // Snapshot new lookups read
+    alignas(64) std::atomic<unsigned> m_phase{0}; // Phase new lookups count themselves in
+    mutable ReaderCount m_readers[2][ReaderShards]; // Lookups in progress by phase parity and thread
+};
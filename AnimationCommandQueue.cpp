@@ -0,0 +1,87 @@
+#include "AnimationCommandQueue.h"
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationCommandQueue class, following the bounded queue design where every
+// slot's sequence number is compared with the position a thread wants to use:
+// - equal to the position: the slot is free for a producer,
+// - one past the position: the slot holds a command for the consumer.
+
+AnimationCommandQueue::AnimationCommandQueue(std::size_t capacity) {
+    // Round the capacity up to a power of two so positions wrap with a mask
+    std::size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    m_cells.reset(new Cell[size]);
+    m_mask = size - 1;
+
+    // Mark every slot as free for the first lap of producers
+    for (std::size_t i = 0; i < size; ++i) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool AnimationCommandQueue::push(const AnimationCommand &command) {
+    std::size_t pos;
+    Cell *cell = claim(pos);
+    if (!cell) {
+        return false;
+    }
+
+    // Write the command and hand the slot to the consumer
+    cell->command = command;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+int AnimationCommandQueue::pushNewInstance(AnimationCommand command, std::atomic<int> &nextInstance, int maxInstances) {
+    std::size_t pos;
+    Cell *cell = claim(pos);
+    if (!cell) {
+        return -1;
+    }
+
+    // Take the handle now that the command is sure to be queued, then hand the slot to the consumer
+    command.instance = nextInstance.fetch_add(1);
+    if (command.instance >= maxInstances) {
+        command.instance = -1;
+    }
+    cell->command = command;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return command.instance;
+}
+
+AnimationCommandQueue::Cell *AnimationCommandQueue::claim(std::size_t &pos) {
+    pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell *cell = &m_cells[pos & m_mask];
+        const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if (difference == 0) {
+            // The slot is free: claim the position, or retry with the position another producer left
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return cell;
+            }
+        } else if (difference < 0) {
+            return nullptr; // The consumer has not emptied this slot yet, so the queue is full
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed); // Another producer took the position
+        }
+    }
+}
+
+bool AnimationCommandQueue::pop(AnimationCommand &command) {
+    // Check whether a producer has finished writing the next slot
+    const std::size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = m_cells[pos & m_mask];
+    const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1) < 0) {
+        return false;
+    }
+
+    // Read the command and hand the slot back to producers for their next lap
+    command = cell.command;
+    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+    m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
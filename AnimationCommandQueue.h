@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// This header file defines the AnimationCommandQueue class, a bounded lock-free queue that lets
+// any number of threads post commands for animation instances while the thread running
+// AnimationManager::updateAll drains them at the start of each update. The class provides functions to:
+// - Push a command from any thread without taking a lock (fails only when the queue is full).
+// - Push a command for a new instance, taking its handle only once the command has a slot.
+// - Pop commands from the single consuming thread.
+// Each slot carries a sequence number that tells producers and the consumer whose turn it is,
+// so producers only contend on one compare-and-swap of the enqueue position.
+
+// Command executed by AnimationManager::updateAll on behalf of another thread
+struct AnimationCommand {
+    enum class Type {
+        Play,     // Restart an instance from its first frame
+        Stop,     // Hold an instance on its current frame
+        Seek,     // Jump an instance to an elapsed time
+        SetSpeed, // Change how many update calls an instance advances per updateAll
+        Spawn,    // Create an instance under a handle reserved by queueSpawn
+        Destroy   // Destroy an instance
+    };
+
+    Type type;    // Kind of command
+    int instance; // Handle of the instance
+    int value;    // Elapsed time for Seek, clip id for Spawn
+    int mode;     // Playback mode for Spawn
+    float speed;  // Speed for SetSpeed
+};
+
+class AnimationCommandQueue {
+public:
+    // Constructor taking the number of slots, rounded up to a power of two
+    explicit AnimationCommandQueue(std::size_t capacity = 4096);
+
+    // Function to add a command from any thread (returns false if the queue is full)
+    bool push(const AnimationCommand &command);
+
+    // Function to add a command for a new instance from any thread, taking the instance's handle from the
+    // counter after a slot is claimed, so a full queue uses up no handle. A handle at or past the limit is
+    // queued as -1 for the consumer to skip. Returns the handle, or -1 if the queue is full or out of handles.
+    int pushNewInstance(AnimationCommand command, std::atomic<int> &nextInstance, int maxInstances);
+
+    // Function to take the oldest command, only called from the consuming thread (returns false if empty)
+    bool pop(AnimationCommand &command);
+
+private:
+    // Slot of the ring buffer
+    struct Cell {
+        std::atomic<std::size_t> sequence; // Position the slot is ready for
+        AnimationCommand command;          // Command stored in the slot
+    };
+
+    // Function to claim the next free slot for a producer (returns nullptr if the queue is full)
+    Cell *claim(std::size_t &pos);
+
+    std::unique_ptr<Cell[]> m_cells;                      // Ring buffer of slots
+    std::size_t m_mask;                                   // Capacity minus one, for wrapping positions
+    alignas(64) std::atomic<std::size_t> m_enqueuePos{0}; // Next position producers write to
+    alignas(64) std::atomic<std::size_t> m_dequeuePos{0}; // Next position the consumer reads from
+};
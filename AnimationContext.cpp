@@ -0,0 +1,1973 @@
+#include "AnimationContext.h"
+#include "AnimationProfiler.h"
+#include "AnimationSpawnShard.h"
+#include "AnimationStateMachine.h"
+#include "AnimationTracer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <set>
+#ifdef ANIMATION_PARALLEL_STL
+#include <execution>
+#endif
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationContext class. The key functionalities implemented include:
+// - update: Updates the animation frame for a specific sprite based on the animation's frequency.
+// - updateAll: Updates all animations in a given map of sprites, or every active instance.
+// - addAnimation: Adds a new animation with specified parameters (texture, sheet size, sprite size, etc.).
+// - deleteAnimation: Deletes an existing animation.
+// - Setters: Modify animation properties such as frequency, sprite size, sheet size, and indices.
+// - setAnimationFrameDurations/seekAnimation: Per-frame durations stored as a prefix-sum table, so the
+//   frame for any elapsed time is found with a binary search instead of stepping through frames.
+// - Instances: Independent copies of an animation stored in flat arrays. updateAll advances them with
+//   one arithmetic kernel that handles every playback mode through per-mode constants instead of
+//   branches, and drops finished one-shot instances from the active set.
+// - Markers: Frames reached by instances are appended to one contiguous event buffer that the caller
+//   drains once per frame, instead of invoking a callback per sprite.
+// - State machines: Compiled into flat tables of states and transitions with clip ids resolved up
+//   front, and evaluated for every instance they drive in one pass of updateAll.
+// - drawAll: Batches the quads of all visible instances by texture. An instance in a crossfade keeps
+//   the frame it fades out of in its own record and emits it as a second quad with interpolated
+//   vertex alpha, so blending needs no extra sprites, draw calls or allocations.
+// - Commands: Other threads post play/stop/seek/speed/spawn/destroy commands to a lock-free queue
+//   drained at the start of updateAll. Spawned handles come from an atomic counter, so a thread can
+//   use a handle in further commands before the instance exists.
+// - Frame publishing: updateAll ends by writing a record per visible instance into a back buffer and
+//   swapping it into the ready slot with one atomic exchange; drawAll swaps the ready buffer out
+//   and draws from it, so drawing frame N can overlap with updating frame N+1 without locks.
+// - Pipelined drawing: drawAllPipelined sorts the quads into segments per texture, then a worker thread
+//   generates the vertices of each segment into a ring of buffers while the drawing thread submits the
+//   segment before it. Two counters of generated and drawn segments are the only synchronisation.
+// - Parallel updates: the kernel only writes to the instance it advances, so chunks of the active set
+//   run as independent jobs with an event buffer each; the buffers are joined in chunk order and the
+//   state machines and the removal of finished instances then run serially as before. Built with
+//   ANIMATION_PARALLEL_STL, updateAll() itself runs the chunks through std::for_each(std::execution::par).
+// - Streaming: addAnimation may run on another thread than updateAll. Names are resolved through a
+//   registry of immutable snapshots that lookups read without locks, clip layouts live in blocks that
+//   never move, and a new clip is filled in before its id is published, so the updating thread only
+//   ever sees complete clips. The name-keyed maps are guarded by a mutex that neither update nor the instance
+//   functions take; update keeps its elapsed time in the clip's block instead.
+// - Statistics: each thread adds to a cache-line-sized block of counters picked by a slot it takes on
+//   first use, so workers of a parallel update never write to the same line. The kernel counts in
+//   locals and adds them once per range; getStats sums the blocks when asked.
+// - Profiling: built with ANIMATION_PROFILING, update and the phases of updateAll are timed into the
+//   AnimationProfiler histograms by scoped timers that otherwise compile to nothing.
+// - Memory accounting: getMemoryUsage walks the maps and arrays and adds up their elements by category,
+//   estimating the links of map nodes, heap block headers and unused capacity as allocator overhead.
+// - Tracing: updateAll and its phases, the chunks run as jobs, drawing, segment generation, event drains
+//   and animation loads open AnimationTracer scopes, which only record while the tracer is started.
+// The file provides the logic for updating and managing the animations of one context. Error handling
+// and frequency-based updates are also implemented to ensure smooth animation transitions.
+
+namespace {
+    const std::size_t MapNodeLinks = 4 * sizeof(void *);       // Colour and links of a std::map node
+    const std::size_t AllocationOverhead = 2 * sizeof(void *); // Typical header and rounding of a heap block
+    const std::size_t SharedBlockOverhead = AllocationOverhead + 3 * sizeof(void *); // Shared pointer control block
+
+    // Function to get the heap bytes of a string, which are zero when it fits in the string object itself
+    std::size_t stringHeapBytes(const std::string &string) {
+        const char *object = reinterpret_cast<const char *>(&string);
+        const bool inPlace = string.data() >= object && string.data() < object + sizeof(std::string);
+        return inPlace ? 0 : string.capacity() + 1;
+    }
+
+    // Function to count a name key and its map node, returning whether the map has the name
+    template <typename Map>
+    bool addMapEntry(const Map &map, const std::string &name, std::size_t &nameStorage, std::size_t &overhead) {
+        if (map.find(name) == map.end()) {
+            return false;
+        }
+        const std::size_t heap = stringHeapBytes(name);
+        nameStorage += sizeof(std::string) + heap;
+        overhead += MapNodeLinks + AllocationOverhead + (heap > 0 ? AllocationOverhead : 0);
+        return true;
+    }
+
+    // Function to count the elements of a vector, and its unused capacity and heap block as overhead
+    template <typename T>
+    void addVector(const std::vector<T> &vector, std::size_t &bytes, std::size_t &overhead) {
+        bytes += vector.size() * sizeof(T);
+        if (vector.capacity() > 0) {
+            overhead += (vector.capacity() - vector.size()) * sizeof(T) + AllocationOverhead;
+        }
+    }
+
+#ifndef ANIMATION_NO_STATS
+    std::atomic<int> g_statSlots{0};                 // Slots given to threads so far
+    thread_local const int t_statSlot = g_statSlots.fetch_add(1); // Slot of this thread's counter block
+#endif
+}
+
+AnimationContext::AnimationContext() = default;
+
+AnimationContext::~AnimationContext() {
+    // Stop the worker of drawAllPipelined if it was started
+    if (m_drawWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_drawMutex);
+            m_drawStopping = true;
+        }
+        m_drawWake.notify_one();
+        m_drawWorker.join();
+    }
+}
+
+AnimationContext::ClipLayout &AnimationContext::clipLayout(int clipId) {
+    return m_clipChunks[clipId / ClipChunkSize]->clips[clipId % ClipChunkSize];
+}
+
+void AnimationContext::update(std::string_view animation, sf::Sprite &sprite) {
+    ANIMATION_PROFILE_SCOPE(Update);
+
+    // Check if the animation has been added, through the registry so a loading thread never blocks the lookup
+    int clipId;
+    {
+        ANIMATION_PROFILE_SCOPE(Lookup);
+        clipId = m_clipIds.find(animation);
+    }
+    if (clipId >= 0) {
+        ClipChunk &chunk = *m_clipChunks[clipId / ClipChunkSize];
+        const ClipLayout &clip = chunk.clips[clipId % ClipChunkSize];
+        const PlaybackParams &params = clip.playback[static_cast<int>(clip.mode)];
+        std::atomic<int> &elapsed = chunk.elapsed[clipId % ClipChunkSize];
+
+        // Calculate the texture rectangle for the current frame, whose index follows from the elapsed time
+        int time = elapsed.load(std::memory_order_relaxed);
+        const int frame = sampleFrame(clip, params, time);
+
+        // Set the sprite texture and texture rectangle
+        sprite.setTexture(*clip.texture);
+        sprite.setTextureRect(frameRect(clip, frame));
+
+        // Advance to the next update call, wrapping or holding depending on the playback mode, unless another
+        // thread moved the animation to a new time meanwhile
+        elapsed.compare_exchange_strong(time, advanceTime(params, time, 1), std::memory_order_relaxed);
+    } else {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+    }
+}
+
+void AnimationContext::updateAll(std::map<std::string, sf::Sprite> &map) {
+    // Iterate through the map and update each animation
+    for (auto &element: map) {
+        update(element.first, element.second);
+    }
+}
+
+void AnimationContext::updateAll() {
+    ANIMATION_PROFILE_SCOPE(UpdateAll);
+    ANIMATION_TRACE_SCOPE("updateAll");
+
+    // Catch up the instances a budgeted update deferred, by advancing every instance in priority order
+    if (m_deferredInstances > 0) {
+        advanceByPriority(std::chrono::steady_clock::time_point::max());
+        return;
+    }
+
+    // Apply what other threads asked for since the last update
+    executeCommands();
+    m_activeFinished.resize(m_activeInstances.size());
+    const std::size_t firstEvent = m_events.size();
+
+#ifdef ANIMATION_PARALLEL_STL
+    // Advance chunks of the active set with the standard parallel algorithms, each chunk into its own event buffer
+    const int chunks = prepareChunks(ParallelGrainSize);
+    {
+        ANIMATION_PROFILE_SCOPE(Advance);
+        ANIMATION_TRACE_SCOPE("advance");
+        std::for_each(std::execution::par, m_chunkEvents.begin(), m_chunkEvents.begin() + chunks,
+                      [this](std::vector<AnimationEvent> &events) {
+                          advanceChunk(static_cast<int>(&events - m_chunkEvents.data()));
+                      });
+    }
+    joinChunkEvents(chunks);
+#else
+    // Advance every active instance on this thread
+    {
+        ANIMATION_PROFILE_SCOPE(Advance);
+        ANIMATION_TRACE_SCOPE("advance");
+        advanceInstances(0, m_activeInstances.size(), m_events);
+    }
+#endif
+
+    // Run state machines, drop finished instances and publish the frame
+    finishUpdate(firstEvent);
+}
+
+void AnimationContext::updateAll(AnimationJobSystem &jobs, int grainSize) {
+    ANIMATION_PROFILE_SCOPE(UpdateAll);
+    ANIMATION_TRACE_SCOPE("updateAll");
+
+    // Catch up the instances a budgeted update deferred, by advancing every instance in priority order
+    if (m_deferredInstances > 0) {
+        advanceByPriority(std::chrono::steady_clock::time_point::max());
+        return;
+    }
+
+    // Apply what other threads asked for since the last update
+    executeCommands();
+    m_activeFinished.resize(m_activeInstances.size());
+    const std::size_t firstEvent = m_events.size();
+
+    // Advance the chunks as jobs; the job only captures the context so it fits std::function's small buffer
+    const int chunks = prepareChunks(grainSize);
+    if (chunks > 0) {
+        ANIMATION_PROFILE_SCOPE(Advance);
+        ANIMATION_TRACE_SCOPE("advance");
+        jobs.parallelFor(chunks, m_chunkJob);
+    }
+    joinChunkEvents(chunks);
+
+    // Run state machines, drop finished instances and publish the frame
+    finishUpdate(firstEvent);
+}
+
+bool AnimationContext::advanceSlot(std::size_t slot, int calls, std::vector<AnimationEvent> &events) {
+    // Advance the instance with the same arithmetic, whatever its playback mode
+    const int instance = m_activeInstances[slot];
+    const ClipLayout &clip = clipLayout(m_instanceClips[instance]);
+    const PlaybackParams &params = clip.playback[m_instanceModes[instance]];
+    const float carried = m_instanceCarries[instance] + m_instanceSpeeds[instance] * static_cast<float>(calls);
+    const int steps = static_cast<int>(carried);
+    m_instanceCarries[instance] = carried - static_cast<float>(steps);
+    const int previousTime = m_instanceTimes[instance];
+    const int time = advanceTime(params, previousTime, steps);
+    const int frame = sampleFrame(clip, params, time);
+    m_instanceTimes[instance] = time;
+    m_instanceRects[instance] = frameRect(clip, frame);
+    m_instanceFadeTimes[instance] = std::max(m_instanceFadeTimes[instance] - calls, 0);
+    m_activeFinished[slot] = time >= params.cap;
+
+    // Record the markers of every frame reached, including those passed over when the instance advances by more
+    // than one update call (speeds above 1 or a budgeted catch-up); past one period every frame has been passed
+    const bool changed = frame != m_instanceFrames[instance];
+    if (clip.markers && steps > 0) {
+        auto recordMarkers = [&](int reached) {
+            auto marked = std::equal_range(clip.markers->begin(), clip.markers->end(), std::make_pair(reached, 0),
+                                           [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                                               return a.first < b.first;
+                                           });
+            for (auto marker = marked.first; marker != marked.second; ++marker) {
+                events.push_back({instanceHandle(instance), marker->second});
+            }
+        };
+        int passedTime = previousTime;
+        int passedFrame = m_instanceFrames[instance];
+        for (int step = std::min(steps - 1, params.wrap); step > 0; --step) {
+            passedTime = advanceTime(params, passedTime, 1);
+            const int passed = sampleFrame(clip, params, passedTime);
+            if (passed != passedFrame) {
+                recordMarkers(passed);
+                passedFrame = passed;
+            }
+        }
+        if (frame != passedFrame) {
+            recordMarkers(frame);
+        }
+    }
+    m_instanceFrames[instance] = frame;
+    if (m_activeFinished[slot]) {
+        events.push_back({instanceHandle(instance), FinishedMarker});
+    }
+    return changed;
+}
+
+void AnimationContext::advanceInstances(std::size_t begin, std::size_t end, std::vector<AnimationEvent> &events) {
+    // Advance the active instances in the range by one update call each
+    const std::size_t firstEvent = events.size();
+    long long framesAdvanced = 0;
+    for (std::size_t slot = begin; slot < end; ++slot) {
+        framesAdvanced += advanceSlot(slot, 1, events);
+    }
+
+    // Count the range once, so the loop itself only touches registers
+    addStat(InstancesUpdatedCounter, static_cast<long long>(end - begin));
+    addStat(FramesAdvancedCounter, framesAdvanced);
+    addStat(EventsEmittedCounter, static_cast<long long>(events.size() - firstEvent));
+}
+
+int AnimationContext::updateAllBudgeted(double budgetMilliseconds) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline =
+            Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double, std::milli>(std::max(budgetMilliseconds, 0.0)));
+    ANIMATION_PROFILE_SCOPE(UpdateAll);
+    ANIMATION_TRACE_SCOPE("updateAllBudgeted");
+    return advanceByPriority(deadline);
+}
+
+int AnimationContext::advanceByPriority(std::chrono::steady_clock::time_point deadline) {
+    // Apply what other threads asked for since the last update; instances started by them owe this update only
+    executeCommands();
+    ++m_budgetTick;
+    const int active = static_cast<int>(m_activeInstances.size());
+    m_activeFinished.assign(m_activeInstances.size(), 0); // Deferred instances are not finished
+
+    // Group the active slots by priority level with a counting sort, keeping their order within a level
+    int levelBegins[PriorityLevels + 1] = {};
+    for (const int instance: m_activeInstances) {
+        ++levelBegins[m_instancePriorities[instance] + 1];
+    }
+    for (int level = 0; level < PriorityLevels; ++level) {
+        levelBegins[level + 1] += levelBegins[level];
+    }
+    int levelEnds[PriorityLevels];
+    std::copy(levelBegins, levelBegins + PriorityLevels, levelEnds);
+    m_budgetOrder.resize(m_activeInstances.size());
+    for (int slot = 0; slot < active; ++slot) {
+        m_budgetOrder[levelEnds[m_instancePriorities[m_activeInstances[slot]]]++] = slot;
+    }
+
+    // Advance each level from where it stopped last time by the updates its instances missed, until the deadline
+    const std::size_t firstEvent = m_events.size();
+    long long framesAdvanced = 0;
+    int advanced = 0;
+    {
+        ANIMATION_PROFILE_SCOPE(Advance);
+        ANIMATION_TRACE_SCOPE("advance");
+        bool expired = false;
+        for (int level = 0; level < PriorityLevels && !expired; ++level) {
+            const int count = levelBegins[level + 1] - levelBegins[level];
+            const int start = count > 0 ? m_budgetCursors[level] % count : 0;
+            for (int visited = 0; visited < count; ++visited) {
+                if (advanced > 0 && advanced % BudgetCheckInterval == 0 &&
+                    std::chrono::steady_clock::now() >= deadline) {
+                    m_budgetCursors[level] = (start + visited) % count;
+                    expired = true;
+                    break;
+                }
+                const int slot = m_budgetOrder[levelBegins[level] + (start + visited) % count];
+                const int instance = m_activeInstances[slot];
+                framesAdvanced += advanceSlot(slot, m_budgetTick - m_instanceUpdateTicks[instance], m_events);
+                m_instanceUpdateTicks[instance] = m_budgetTick;
+                ++advanced;
+            }
+        }
+    }
+    m_deferredInstances = active - advanced;
+    addStat(InstancesUpdatedCounter, advanced);
+    addStat(FramesAdvancedCounter, framesAdvanced);
+    addStat(EventsEmittedCounter, static_cast<long long>(m_events.size() - firstEvent));
+    addStat(InstancesDeferredCounter, m_deferredInstances);
+
+    // Run state machines, drop finished instances and publish the frame
+    finishUpdate(firstEvent);
+    return m_deferredInstances;
+}
+
+void AnimationContext::setInstancePriority(int handle, int priority) {
+    // Set the level updateAllBudgeted advances the instance at
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        m_instancePriorities[instance] = std::clamp(priority, 0, PriorityLevels - 1);
+    }
+}
+
+int AnimationContext::getDeferredCount() const {
+    return m_deferredInstances;
+}
+
+void AnimationContext::advanceChunk(int chunk) {
+    ANIMATION_TRACE_SCOPE("advanceChunk");
+
+    // Advance the chunk's instances into the chunk's own event buffer
+    const std::size_t begin = static_cast<std::size_t>(chunk) * m_chunkSize;
+    const std::size_t end = std::min(begin + m_chunkSize, m_activeInstances.size());
+    m_chunkEvents[chunk].clear();
+    advanceInstances(begin, end, m_chunkEvents[chunk]);
+}
+
+int AnimationContext::prepareChunks(int grainSize) {
+    // Split the active set into chunks of grainSize instances, each with its own event buffer
+    m_chunkSize = static_cast<std::size_t>(std::max(grainSize, 1));
+    const int chunks = static_cast<int>((m_activeInstances.size() + m_chunkSize - 1) / m_chunkSize);
+    if (m_chunkEvents.size() < static_cast<std::size_t>(chunks)) {
+        m_chunkEvents.resize(chunks);
+    }
+
+    // Keep the same room for events in each chunk's buffer as the joined buffer keeps for every instance
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        m_chunkEvents[chunk].reserve(m_chunkSize * ReservedEventsPerInstance);
+    }
+    return chunks;
+}
+
+void AnimationContext::joinChunkEvents(int chunks) {
+    ANIMATION_PROFILE_SCOPE(Events);
+    ANIMATION_TRACE_SCOPE("joinEvents");
+
+    // Append the events in chunk order, so they come out exactly as the serial kernel records them
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        m_events.insert(m_events.end(), m_chunkEvents[chunk].begin(), m_chunkEvents[chunk].end());
+    }
+}
+
+void AnimationContext::finishUpdate(std::size_t firstEvent) {
+    addStat(UpdatesCounter, 1);
+
+    // Take the first transition whose condition holds for each instance driven by a state machine
+    {
+        ANIMATION_PROFILE_SCOPE(StateMachines);
+        ANIMATION_TRACE_SCOPE("stateMachines");
+
+        // Find where the events of each instance driven by a state machine start; the kernel records the events
+        // of an instance one after the other, so they run from there while the instance stays the same
+        if (!m_machineInstances.empty()) {
+            for (std::size_t event = m_events.size(); event-- > firstEvent;) {
+                const int handle = m_events[event].instance;
+                const int instance = handle & (MaxInstances - 1);
+                if (m_instanceMachines[instance] >= 0 && handle == instanceHandle(instance)) {
+                    m_instanceFirstEvents[instance] = static_cast<int>(event);
+                }
+            }
+        }
+        for (const int instance: m_machineInstances) {
+            const int state = m_instanceStates[instance];
+            const float *parameters = &m_instanceParameters[instance * StateMachineParameters];
+            const ClipLayout &clip = clipLayout(m_instanceClips[instance]);
+            const bool finished = m_instanceTimes[instance] >= clip.playback[m_instanceModes[instance]].cap;
+            for (int index = m_stateTransitionBegins[state]; index < m_stateTransitionEnds[state]; ++index) {
+                const StateTransition &transition = m_transitions[index];
+                bool holds;
+                switch (static_cast<AnimationStateMachine::Condition>(transition.condition)) {
+                    case AnimationStateMachine::Condition::Less:
+                        holds = parameters[transition.parameter] < transition.threshold;
+                        break;
+                    case AnimationStateMachine::Condition::Greater:
+                        holds = parameters[transition.parameter] > transition.threshold;
+                        break;
+                    case AnimationStateMachine::Condition::Equal:
+                        holds = parameters[transition.parameter] == transition.threshold;
+                        break;
+                    case AnimationStateMachine::Condition::NotEqual:
+                        holds = parameters[transition.parameter] != transition.threshold;
+                        break;
+                    case AnimationStateMachine::Condition::Marker:
+                        holds = reachedMarker(instance, transition.marker);
+                        break;
+                    default:
+                        holds = finished;
+                        break;
+                }
+                if (holds) {
+                    enterState(instance, transition.target);
+                    break;
+                }
+            }
+            m_instanceFirstEvents[instance] = -1;
+        }
+    }
+
+    // Drop finished instances, walking backwards so the instances swapped into freed slots are already checked
+    for (std::size_t slot = m_activeFinished.size(); slot-- > 0;) {
+        if (m_activeFinished[slot]) {
+            const int instance = m_activeInstances[slot];
+            if (m_instanceModes[instance] == static_cast<int>(PlaybackMode::OnceRelease)) {
+                destroyInstanceAt(instance);
+            } else {
+                deactivateInstance(instance); // Hold the last frame without further updates
+            }
+        }
+    }
+
+    // Hand the new frame to drawAll
+    publishFrame();
+}
+
+bool AnimationContext::reachedMarker(int instance, int marker) const {
+    // Look through the events the instance recorded in this update
+    const int firstEvent = m_instanceFirstEvents[instance];
+    if (firstEvent < 0) {
+        return false;
+    }
+    const int handle = instanceHandle(instance);
+    for (std::size_t event = static_cast<std::size_t>(firstEvent);
+         event < m_events.size() && m_events[event].instance == handle; ++event) {
+        if (m_events[event].marker == marker) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AnimationContext::addAnimation(const std::string &animation, const sf::Texture &texture,
+                                    sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                                    sf::Vector2i index, int frequency,
+                                    sf::Vector2i startingIndex) {
+    // Copy the texture before taking the lock, so the copy never holds up other callers, then add the animation
+    ANIMATION_TRACE_SCOPE("addAnimation");
+    std::shared_ptr<sf::Texture> copy = std::make_shared<sf::Texture>(texture);
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_textures[animation] = std::move(copy);
+    const int clipId = initAnimation(animation, sheetSize, spriteSize, index, frequency, startingIndex);
+    if (clipId >= 0) {
+        m_clipIds.insert(animation, clipId);
+    }
+}
+
+void AnimationContext::addAnimation(const std::string &animation, const std::string &textureAnimation,
+                                    sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                                    sf::Vector2i index, int frequency,
+                                    sf::Vector2i startingIndex) {
+    ANIMATION_TRACE_SCOPE("addAnimation");
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    auto texture = m_textures.find(textureAnimation);
+    if (texture == m_textures.end()) {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << textureAnimation << "\"!" << std::endl;
+        return;
+    }
+
+    // Share the texture and add the animation with the specified parameters
+    m_textures[animation] = texture->second;
+    const int clipId = initAnimation(animation, sheetSize, spriteSize, index, frequency, startingIndex);
+    if (clipId >= 0) {
+        m_clipIds.insert(animation, clipId);
+    }
+}
+
+void AnimationContext::addAnimations(const std::vector<AnimationDefinition> &animations) {
+    ANIMATION_TRACE_SCOPE("addAnimations");
+
+    // Copy the textures before taking the lock, like addAnimation
+    std::vector<std::shared_ptr<sf::Texture>> copies;
+    copies.reserve(animations.size());
+    for (const AnimationDefinition &definition: animations) {
+        copies.push_back(std::make_shared<sf::Texture>(*definition.texture));
+    }
+
+    // Set up every animation, then publish the new names with one copy of the registry
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    std::vector<std::pair<std::string, int>> published;
+    published.reserve(animations.size());
+    std::set<std::string_view> names;
+    for (std::size_t i = 0; i < animations.size(); ++i) {
+        const AnimationDefinition &definition = animations[i];
+        if (!names.insert(definition.animation).second) {
+            // Output an error message instead of giving a name that is not published yet a second clip id
+            std::cerr << "Animation \"" << definition.animation << "\" is added twice!" << std::endl;
+            continue;
+        }
+        m_textures[definition.animation] = std::move(copies[i]);
+        const int clipId = initAnimation(definition.animation, definition.sheetSize, definition.spriteSize,
+                                         definition.index, definition.frequency, definition.startingIndex);
+        if (clipId >= 0) {
+            published.emplace_back(definition.animation, clipId);
+        }
+    }
+    m_clipIds.insert(published);
+}
+
+int AnimationContext::initAnimation(const std::string &animation, sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                                    sf::Vector2i index, int frequency, sf::Vector2i startingIndex) {
+    // Add a new animation with the specified parameters
+    m_sheetSizes[animation] = sheetSize;
+    m_spriteSizes[animation] = spriteSize;
+    m_startingIndices[animation] = startingIndex;
+    m_endingIndices[animation] = sheetSize;
+    m_frequencies[animation] = frequency;
+
+    // An animation added again keeps its clip id and only has its clip rebuilt
+    if (m_clipIds.find(animation) >= 0) {
+        refreshClip(animation);
+        applyAnimationIndex(animation, index);
+        return -1;
+    }
+
+    // Give the animation a clip id, reusing one from a deleted animation if possible
+    int clipId;
+    if (!m_freeClips.empty()) {
+        clipId = m_freeClips.back();
+        m_freeClips.pop_back();
+    } else {
+        clipId = m_clipCount.load();
+        if (clipId >= ClipChunkSize * MaxClipChunks) {
+            // Output an error message if the context cannot hold another animation
+            std::cerr << "Too many animations for \"" << animation << "\"!" << std::endl;
+            return -1;
+        }
+        if (clipId % ClipChunkSize == 0) {
+            m_clipChunks[clipId / ClipChunkSize].reset(new ClipChunk());
+        }
+        m_clipCount.store(clipId + 1); // Queued spawns check their clip id against the count
+    }
+
+    // Fill in the clip before the caller publishes its id, so other threads never see it half written
+    ClipChunk &chunk = *m_clipChunks[clipId / ClipChunkSize];
+    refreshClip(animation, chunk.clips[clipId % ClipChunkSize]);
+    applyAnimationIndex(clipId, index);
+    chunk.live[clipId % ClipChunkSize].store(true);
+    return clipId;
+}
+
+void AnimationContext::deleteAnimation(const std::string &animation) {
+    // Destroy the instances playing the animation and recycle its clip id
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    const int clipId = m_clipIds.find(animation);
+    if (clipId >= 0 && std::find(m_stateClips.begin(), m_stateClips.end(), clipId) != m_stateClips.end()) {
+        // Output an error message instead of letting the state machine play whatever reuses the clip id
+        std::cerr << "Animation \"" << animation << "\" is used by a state machine!" << std::endl;
+        return;
+    }
+    if (clipId >= 0) {
+        for (int instance = 0; instance < static_cast<int>(m_instanceClips.size()); ++instance) {
+            if (m_instanceClips[instance] == clipId) {
+                destroyInstanceAt(instance);
+            } else if (m_instanceFadeClips[instance] == clipId) {
+                m_instanceFadeTimes[instance] = 0; // Stop fading out of the deleted animation
+            }
+        }
+        m_clipChunks[clipId / ClipChunkSize]->live[clipId % ClipChunkSize].store(false); // Lets queued spawns detect it
+        m_clipIds.erase(animation);
+        m_freeClips.push_back(clipId);
+    }
+
+    // Remove the animation entry from all maps (a shared texture lives on with the other animations)
+    m_textures.erase(animation);
+    m_startingIndices.erase(animation);
+    m_endingIndices.erase(animation);
+    m_sheetSizes.erase(animation);
+    m_spriteSizes.erase(animation);
+    m_frequencies.erase(animation);
+    m_frameEndTimes.erase(animation);
+    m_playbackModes.erase(animation);
+    m_markers.erase(animation);
+}
+
+void AnimationContext::setAnimationFrequency(const std::string &animation, int frequency) {
+    // Set the update frequency for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_frequencies[animation] = frequency;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationSpriteSize(const std::string &animation, sf::Vector2i size) {
+    // Set the sprite size for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_spriteSizes[animation] = size;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationSheetSize(const std::string &animation, sf::Vector2i size) {
+    // Set the sheet size for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_sheetSizes[animation] = size;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationIndex(const std::string &animation, sf::Vector2i index) {
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    applyAnimationIndex(animation, index);
+}
+
+void AnimationContext::applyAnimationIndex(const std::string &animation, sf::Vector2i index) {
+    // Only animations added with addAnimation have a clip id
+    const int clipId = m_clipIds.find(animation);
+    if (clipId >= 0) {
+        applyAnimationIndex(clipId, index);
+    }
+}
+
+void AnimationContext::applyAnimationIndex(int clipId, sf::Vector2i index) {
+    // Set the current index of the clip by moving the elapsed time to the start of its frame
+    const ClipLayout &clip = clipLayout(clipId);
+    const int frame = std::clamp(index.x * clip.sheetRows + index.y - clip.firstFrame, 0, clip.frameCount - 1);
+    setElapsed(clipId, clip.mode == PlaybackMode::Reverse ? clip.duration - frameStartTime(clip, frame + 1)
+                                                           : frameStartTime(clip, frame));
+}
+
+void AnimationContext::setElapsed(int clipId, int elapsed) {
+    // Store the elapsed update calls of update() on the clip
+    m_clipChunks[clipId / ClipChunkSize]->elapsed[clipId % ClipChunkSize].store(elapsed, std::memory_order_relaxed);
+}
+
+void AnimationContext::setAnimationTexture(const std::string &animation, const sf::Texture &texture) {
+    // Set the texture for the specified animation, leaving animations that shared the old one untouched; the
+    // copy is made before taking the lock
+    std::shared_ptr<sf::Texture> copy = std::make_shared<sf::Texture>(texture);
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_textures[animation] = std::move(copy);
+    refreshClip(animation);
+}
+
+void AnimationContext::resetAnimationIndex(const std::string &animation) {
+    // Reset the current index to the starting index for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    const int clipId = m_clipIds.find(animation);
+    if (clipId >= 0) {
+        setElapsed(clipId, 0);
+    }
+}
+
+void AnimationContext::setAnimationStartingIndex(const std::string &animation, sf::Vector2i index) {
+    // Set the starting index for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_startingIndices[animation] = index;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationEndingIndex(const std::string &animation, sf::Vector2i index) {
+    // Set the ending index for the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_endingIndices[animation] = index;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationPlaybackMode(const std::string &animation, PlaybackMode mode) {
+    // Set the playback mode used by update and by new instances of the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_playbackModes[animation] = mode;
+    refreshClip(animation);
+}
+
+void AnimationContext::setAnimationFrameDurations(const std::string &animation, const std::vector<int> &durations) {
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    if (durations.empty()) {
+        // Fall back to the frequency-based update
+        m_frameEndTimes.erase(animation);
+    } else {
+        // Store the running total of the durations so each entry marks the end of its frame's time slot
+        std::vector<int> frameEndTimes;
+        frameEndTimes.reserve(durations.size());
+        int total = 0;
+        for (int duration: durations) {
+            total += std::max(duration, 1); // Every frame is shown for at least one update call
+            frameEndTimes.push_back(total);
+        }
+        m_frameEndTimes[animation] = std::move(frameEndTimes);
+    }
+    refreshClip(animation);
+    const int clipId = m_clipIds.find(animation);
+    if (clipId >= 0) {
+        setElapsed(clipId, 0);
+    }
+}
+
+int AnimationContext::addAnimationMarker(const std::string &animation, int frame, const std::string &marker) {
+    // Keep the marked frames sorted so updateAll can find a frame's markers with a binary search
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    std::vector<std::pair<int, int>> &markers = m_markers[animation];
+    const std::pair<int, int> entry(frame, markerId(marker));
+    markers.insert(std::upper_bound(markers.begin(), markers.end(), entry), entry);
+    refreshClip(animation);
+    return entry.second;
+}
+
+void AnimationContext::clearAnimationMarkers(const std::string &animation) {
+    // Remove the marked frames of the specified animation
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    m_markers.erase(animation);
+    refreshClip(animation);
+}
+
+int AnimationContext::getMarkerId(const std::string &marker) {
+    // Look up the id given to the marker name by addAnimationMarker
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    auto id = m_markerIds.find(marker);
+    return id != m_markerIds.end() ? id->second : -1;
+}
+
+void AnimationContext::seekAnimation(const std::string &animation, int elapsed) {
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    const int clipId = m_clipIds.find(animation);
+    if (clipId < 0) {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+        return;
+    }
+
+    // Wrap or clamp the time like the playback mode would, then index the frame directly
+    const ClipLayout &clip = clipLayout(clipId);
+    const PlaybackParams &params = clip.playback[static_cast<int>(clip.mode)];
+    setElapsed(clipId, advanceTime(params, 0, std::max(elapsed, 0)));
+}
+
+int AnimationContext::createInstance(const std::string &animation) {
+    // Use the playback mode set for the animation, copied into its clip
+    const int clipId = m_clipIds.find(animation);
+    return createInstance(animation, clipId >= 0 ? clipLayout(clipId).mode : PlaybackMode::Loop);
+}
+
+int AnimationContext::createInstance(const std::string &animation, PlaybackMode mode) {
+    const int clipId = m_clipIds.find(animation);
+    if (clipId < 0) {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+        return -1;
+    }
+
+    // Start the instance on its first frame
+    const int instance = allocateInstance();
+    if (instance < 0) {
+        return -1;
+    }
+    spawnInstance(instance, clipId, static_cast<int>(mode));
+    return instanceHandle(instance);
+}
+
+void AnimationContext::destroyInstance(int handle) {
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        destroyInstanceAt(instance);
+    }
+}
+
+void AnimationContext::destroyInstanceAt(int instance) {
+    // Stop driving the instance with its state machine
+    const int machineSlot = m_instanceMachineSlots[instance];
+    if (machineSlot >= 0) {
+        const int moved = m_machineInstances.back();
+        m_machineInstances[machineSlot] = moved;
+        m_instanceMachineSlots[moved] = machineSlot;
+        m_machineInstances.pop_back();
+        m_instanceMachineSlots[instance] = -1;
+    }
+    m_instanceMachines[instance] = -1;
+    m_instanceStates[instance] = -1;
+
+    // Remove the instance from the active and live sets, telling whoever waits for the instance's events that
+    // none will follow under this handle, and recycle its index
+    deactivateInstance(instance);
+    removeLiveInstance(instance);
+    m_instanceClips[instance] = -1;
+    m_events.push_back({instanceHandle(instance), DestroyedMarker});
+    recycleInstance(instance);
+}
+
+void AnimationContext::recycleInstance(int instance) {
+    // Move the index to its next generation, so handles given out before no longer match it
+    m_instanceGenerations[instance] = (m_instanceGenerations[instance] + 1) % InstanceGenerations;
+    m_freeInstances.push_back(instance);
+}
+
+int AnimationContext::instanceFromHandle(int handle) const {
+    // Split the handle into the instance's index and the generation it was given out under, which must still be
+    // the index's generation for the handle to refer to a live instance
+    const int instance = handle & (MaxInstances - 1);
+    if (handle < 0 || instance >= static_cast<int>(m_instanceClips.size()) || m_instanceClips[instance] < 0 ||
+        handle >> InstanceIndexBits != m_instanceGenerations[instance]) {
+        return -1;
+    }
+    return instance;
+}
+
+int AnimationContext::instanceHandle(int instance) const {
+    // Put the index's generation above the index
+    return instance | m_instanceGenerations[instance] << InstanceIndexBits;
+}
+
+void AnimationContext::restartInstance(int handle) {
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        restartInstanceAt(instance);
+    }
+}
+
+void AnimationContext::restartInstanceAt(int instance) {
+    // Rewind the instance and put it back in the active set, owing no budgeted update from before the rewind
+    const ClipLayout &clip = clipLayout(m_instanceClips[instance]);
+    m_instanceTimes[instance] = 0;
+    m_instanceCarries[instance] = 0.f;
+    m_instanceUpdateTicks[instance] = m_budgetTick;
+    m_instanceFrames[instance] = sampleFrame(clip, clip.playback[m_instanceModes[instance]], 0);
+    m_instanceRects[instance] = frameRect(clip, m_instanceFrames[instance]);
+    activateInstance(instance);
+}
+
+void AnimationContext::stopInstance(int handle) {
+    // Take the instance out of the active set, keeping its current frame
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        deactivateInstance(instance);
+    }
+}
+
+void AnimationContext::seekInstance(int handle, int elapsed) {
+    const int instance = instanceFromHandle(handle);
+    if (instance < 0) {
+        return; // Nothing to seek
+    }
+
+    // Wrap or clamp the time like the playback mode would, then index the frame directly; the updates the
+    // instance was deferred for before the seek are no longer owed
+    const ClipLayout &clip = clipLayout(m_instanceClips[instance]);
+    const PlaybackParams &params = clip.playback[m_instanceModes[instance]];
+    m_instanceTimes[instance] = advanceTime(params, 0, std::max(elapsed, 0));
+    m_instanceCarries[instance] = 0.f;
+    m_instanceUpdateTicks[instance] = m_budgetTick;
+    m_instanceFrames[instance] = sampleFrame(clip, params, m_instanceTimes[instance]);
+    m_instanceRects[instance] = frameRect(clip, m_instanceFrames[instance]);
+}
+
+void AnimationContext::setInstanceSpeed(int handle, float speed) {
+    // Set the speed, never running backwards (use PlaybackMode::Reverse for that)
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        m_instanceSpeeds[instance] = std::max(speed, 0.f);
+    }
+}
+
+bool AnimationContext::isInstanceActive(int handle) {
+    // Released and held instances are no longer in the active set
+    const int instance = instanceFromHandle(handle);
+    return instance >= 0 && m_instanceActiveSlots[instance] >= 0;
+}
+
+void AnimationContext::applyInstance(int handle, sf::Sprite &sprite) {
+    const int instance = instanceFromHandle(handle);
+    if (instance < 0) {
+        // Output an error message if the handle does not refer to an instance
+        std::cerr << "No animation instance " << handle << "!" << std::endl;
+        return;
+    }
+
+    // Set the sprite texture and texture rectangle
+    sprite.setTexture(*clipLayout(m_instanceClips[instance]).texture);
+    sprite.setTextureRect(m_instanceRects[instance]);
+}
+
+int AnimationContext::getAnimationId(const std::string &animation) {
+    // Look up the clip id of the animation
+    const int clipId = m_clipIds.find(animation);
+    if (clipId < 0) {
+        addStat(LookupMissesCounter, 1);
+    }
+    return clipId;
+}
+
+bool AnimationContext::queuePlay(int instance) {
+    // Queue a restart of the instance
+    return m_commands.push({AnimationCommand::Type::Play, instance, 0, 0, 0.f});
+}
+
+bool AnimationContext::queueStop(int instance) {
+    // Queue a stop of the instance
+    return m_commands.push({AnimationCommand::Type::Stop, instance, 0, 0, 0.f});
+}
+
+bool AnimationContext::queueSeek(int instance, int elapsed) {
+    // Queue a seek of the instance
+    return m_commands.push({AnimationCommand::Type::Seek, instance, elapsed, 0, 0.f});
+}
+
+bool AnimationContext::queueSetSpeed(int instance, float speed) {
+    // Queue a speed change of the instance
+    return m_commands.push({AnimationCommand::Type::SetSpeed, instance, 0, 0, speed});
+}
+
+int AnimationContext::queueSpawn(int animationId, PlaybackMode mode) {
+    // Queue the creation of the instance under a handle no other thread can get, taken only once the command
+    // has a slot, so a full queue does not use up a handle that would never be created or freed
+    return m_commands.pushNewInstance({AnimationCommand::Type::Spawn, -1, animationId, static_cast<int>(mode), 0.f},
+                                      m_nextInstance, MaxInstances);
+}
+
+bool AnimationContext::queueDestroy(int instance) {
+    // Queue the destruction of the instance
+    return m_commands.push({AnimationCommand::Type::Destroy, instance, 0, 0, 0.f});
+}
+
+void AnimationContext::crossfadeInstance(int handle, const std::string &animation, int duration) {
+    const int instance = instanceFromHandle(handle);
+    if (instance < 0) {
+        return; // Nothing to crossfade
+    }
+    const int clipId = m_clipIds.find(animation);
+    if (clipId < 0) {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+        return;
+    }
+
+    // Keep the current frame for the fade and start the new animation from its first frame
+    beginCrossfade(instance, duration);
+    m_instanceClips[instance] = clipId;
+    m_instanceModes[instance] = static_cast<int>(clipLayout(clipId).mode);
+    restartInstanceAt(instance);
+}
+
+void AnimationContext::setInstancePosition(int handle, sf::Vector2f position) {
+    // Set the position of the instance's top-left corner
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        m_instancePositions[instance] = position;
+    }
+}
+
+void AnimationContext::setInstanceScale(int handle, sf::Vector2f scale) {
+    // Set the scale applied to the instance's frame size
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        m_instanceScales[instance] = scale;
+    }
+}
+
+void AnimationContext::setInstanceVisible(int handle, bool visible) {
+    // Set whether drawAll draws the instance
+    const int instance = instanceFromHandle(handle);
+    if (instance >= 0) {
+        m_instanceVisible[instance] = visible;
+    }
+}
+
+void AnimationContext::drawAll(sf::RenderTarget &target, sf::RenderStates states) {
+    ANIMATION_TRACE_SCOPE("drawAll");
+
+    // Take the latest published frame and empty the batches while keeping their memory
+    takeFrame();
+
+    // Append the quad of every record, preceded by the frame it is fading out of
+    for (const RenderRecord &record: m_frames[m_frontFrame]) {
+        if (record.fadeTexture) {
+            appendQuad(batchVertices(record.fadeTexture), record.position, record.scale, record.fadeRect,
+                       static_cast<std::uint8_t>(255.f * (1.f - record.weight)));
+        }
+        appendQuad(batchVertices(record.texture), record.position, record.scale, record.rect,
+                   static_cast<std::uint8_t>(255.f * record.weight));
+    }
+
+    // Draw each batch with a single call
+    DrawStats frame;
+    const sf::Texture *previous = nullptr;
+    for (RenderBatch &batch: m_batches) {
+        if (!batch.vertices.empty()) {
+            states.texture = batch.texture;
+            target.draw(batch.vertices.data(), batch.vertices.size(), sf::PrimitiveType::Triangles, states);
+            countDrawCall(frame, batch.texture, previous, false, batch.vertices.size());
+            previous = batch.texture;
+        }
+    }
+    recordDrawStats(frame);
+}
+
+void AnimationContext::drawAllPipelined(sf::RenderTarget &target, sf::RenderStates states) {
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const Clock::time_point start = Clock::now();
+    ANIMATION_TRACE_SCOPE("drawAllPipelined");
+
+    // Take the latest published frame and sort its quads into batches, preceding each quad by its fade
+    takeFrame();
+    const std::vector<RenderRecord> &records = m_frames[m_frontFrame];
+    for (int record = 0; record < static_cast<int>(records.size()); ++record) {
+        if (records[record].fadeTexture) {
+            findBatch(records[record].fadeTexture).quads.push_back(record * 2 + 1);
+        }
+        findBatch(records[record].texture).quads.push_back(record * 2);
+    }
+
+    // Cut the batches into segments small enough to keep the worker a buffer ahead of drawing
+    m_drawSegments.clear();
+    for (int batch = 0; batch < static_cast<int>(m_batches.size()); ++batch) {
+        const int quads = static_cast<int>(m_batches[batch].quads.size());
+        for (int begin = 0; begin < quads; begin += SegmentQuads) {
+            m_drawSegments.push_back({batch, begin, std::min(begin + SegmentQuads, quads)});
+        }
+    }
+    const int segments = static_cast<int>(m_drawSegments.size());
+    if (segments == 0) {
+        recordDrawStats(DrawStats());
+        return;
+    }
+
+    // Hand the frame to the worker, starting it the first time
+    m_segmentsGenerated.store(0, std::memory_order_relaxed);
+    m_segmentsDrawn.store(0, std::memory_order_relaxed);
+    m_generateMilliseconds = 0.0;
+    if (!m_drawWorker.joinable()) {
+        m_drawWorker = std::thread(&AnimationContext::generateSegments, this);
+    }
+    const Clock::time_point pipelineStart = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_drawMutex);
+        ++m_drawFrames;
+    }
+    m_drawWake.notify_one();
+
+    // Draw each segment as soon as the worker has generated it, freeing its buffer for the segment after next
+    double submit = 0.0;
+    double stall = 0.0;
+    DrawStats frame;
+    for (int segment = 0; segment < segments; ++segment) {
+        const Clock::time_point waitStart = Clock::now();
+        while (m_segmentsGenerated.load(std::memory_order_acquire) <= segment) {
+            std::this_thread::yield();
+        }
+        const Clock::time_point drawStart = Clock::now();
+        {
+            ANIMATION_TRACE_SCOPE("drawSegment");
+            const std::vector<sf::Vertex> &vertices = m_drawBuffers[segment % DrawBuffers];
+            const int batch = m_drawSegments[segment].batch;
+            const int previousBatch = segment > 0 ? m_drawSegments[segment - 1].batch : -1;
+            states.texture = m_batches[batch].texture;
+            target.draw(vertices.data(), vertices.size(), sf::PrimitiveType::Triangles, states);
+            countDrawCall(frame, states.texture, previousBatch >= 0 ? m_batches[previousBatch].texture : nullptr,
+                          previousBatch == batch, vertices.size());
+        }
+        const Clock::time_point drawEnd = Clock::now();
+        m_segmentsDrawn.store(segment + 1, std::memory_order_release);
+        stall += Milliseconds(drawStart - waitStart).count();
+        submit += Milliseconds(drawEnd - drawStart).count();
+    }
+
+    // Accumulate the times; whatever generation and drawing took beyond the pipeline's length ran at once
+    const Clock::time_point end = Clock::now();
+    const double pipeline = Milliseconds(end - pipelineStart).count();
+    m_drawTimings.generateMilliseconds += m_generateMilliseconds;
+    m_drawTimings.submitMilliseconds += submit;
+    m_drawTimings.stallMilliseconds += stall;
+    m_drawTimings.totalMilliseconds += Milliseconds(end - start).count();
+    m_drawTimings.overlapMilliseconds += std::max(m_generateMilliseconds + submit - pipeline, 0.0);
+    m_drawTimings.frames += 1;
+    m_drawTimings.segments += segments;
+    recordDrawStats(frame);
+}
+
+AnimationContext::DrawTimings AnimationContext::getDrawTimings() const {
+    return m_drawTimings;
+}
+
+void AnimationContext::resetDrawTimings() {
+    m_drawTimings = DrawTimings();
+}
+
+void AnimationContext::countDrawCall(DrawStats &frame, const sf::Texture *texture, const sf::Texture *previous,
+                                     bool sameBatch, std::size_t vertices) {
+    // Every call after the first ends the batch before it, on a texture change or a full buffer
+    if (frame.drawCalls > 0) {
+        if (sameBatch) {
+            ++frame.bufferBreaks;
+        } else {
+            ++frame.textureBreaks;
+        }
+    }
+    if (frame.drawCalls == 0 || texture != previous) {
+        ++frame.textureSwitches;
+    }
+    ++frame.drawCalls;
+    frame.verticesSubmitted += static_cast<long long>(vertices);
+}
+
+void AnimationContext::recordDrawStats(const DrawStats &frame) {
+    // Keep the frame for getFrameDrawStats and add it to the totals
+    m_frameDrawStats = frame;
+    addStat(FramesDrawnCounter, 1);
+    addStat(DrawCallsCounter, frame.drawCalls);
+    addStat(TextureSwitchesCounter, frame.textureSwitches);
+    addStat(VerticesSubmittedCounter, frame.verticesSubmitted);
+    addStat(TextureBreaksCounter, frame.textureBreaks);
+    addStat(BufferBreaksCounter, frame.bufferBreaks);
+}
+
+void AnimationContext::addStat(StatCounter counter, long long amount) {
+#ifndef ANIMATION_NO_STATS
+    // Only threads sharing a slot contend, so a relaxed add is enough and usually stays in this core's cache
+    m_statBlocks[t_statSlot % StatBlocks].counters[counter].fetch_add(amount, std::memory_order_relaxed);
+#else
+    (void) counter;
+    (void) amount;
+#endif
+}
+
+void AnimationContext::getClipInstances(std::vector<ClipInstances> &clips) {
+    // Count the instances and active instances of every clip id
+    std::vector<int> instances(static_cast<std::size_t>(m_clipCount.load(std::memory_order_acquire)), 0);
+    std::vector<int> active(instances.size(), 0);
+    for (const int instance: m_liveInstances) {
+        const int clip = m_instanceClips[instance];
+        if (clip >= 0 && clip < static_cast<int>(instances.size())) {
+            ++instances[clip];
+            active[clip] += m_instanceActiveSlots[instance] >= 0;
+        }
+    }
+
+    // Report them under the names of the animations
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    clips.clear();
+    for (const auto &texture: m_textures) {
+        const int clip = m_clipIds.find(texture.first);
+        if (clip >= 0 && clip < static_cast<int>(instances.size())) {
+            clips.push_back({texture.first, instances[clip], active[clip]});
+        }
+    }
+}
+
+std::size_t AnimationContext::MemoryUsage::total() const {
+    return texturePixels + clipMetadata + frameTables + instanceState + nameStorage + allocatorOverhead;
+}
+
+AnimationContext::MemoryUsage AnimationContext::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    MemoryUsage usage;
+
+    // Add up every animation, then take back the pixels of textures shared by several of them
+    std::vector<const sf::Texture *> textures;
+    for (const auto &texture: m_textures) {
+        addAnimationMemory(texture.first, usage);
+        textures.push_back(texture.second.get());
+    }
+    std::sort(textures.begin(), textures.end());
+    for (std::size_t i = 1; i < textures.size(); ++i) {
+        if (textures[i] == textures[i - 1]) {
+            const sf::Vector2u size = textures[i]->getSize();
+            usage.texturePixels -= static_cast<std::size_t>(size.x) * size.y * 4;
+            usage.clipMetadata -= sizeof(sf::Texture);
+            usage.allocatorOverhead -= SharedBlockOverhead;
+        }
+    }
+
+    // Count the whole blocks of flattened clips rather than the clips in use
+    for (const std::unique_ptr<ClipChunk> &chunk: m_clipChunks) {
+        if (chunk) {
+            usage.clipMetadata += sizeof(ClipChunk);
+            usage.allocatorOverhead += AllocationOverhead;
+        }
+    }
+    addVector(m_freeClips, usage.clipMetadata, usage.allocatorOverhead);
+
+    // Marker names
+    for (const auto &marker: m_markerIds) {
+        addMapEntry(m_markerIds, marker.first, usage.nameStorage, usage.allocatorOverhead);
+        usage.clipMetadata += sizeof(int);
+    }
+
+    // State machine tables
+    addVector(m_stateClips, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_stateModes, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_stateBlends, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_stateTransitionBegins, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_stateTransitionEnds, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_transitions, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_machineFirstStates, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_machineInitialStates, usage.clipMetadata, usage.allocatorOverhead);
+    addVector(m_machineParameters, usage.clipMetadata, usage.allocatorOverhead);
+
+    // Instance arrays, including free slots, and the buffers that grow with the instances
+    addVector(m_instanceClips, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceModes, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceTimes, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceSpeeds, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceCarries, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFrames, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceRects, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceActiveSlots, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFirstEvents, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceMachines, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceStates, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceParameters, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceMachineSlots, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instancePositions, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceScales, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceVisible, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFadeClips, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFadeRects, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFadeTimes, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceFadeDurations, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instancePriorities, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceUpdateTicks, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_activeInstances, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_activeFinished, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceGenerations, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_freeInstances, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_instanceLiveSlots, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_liveInstances, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_machineInstances, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_budgetOrder, usage.instanceState, usage.allocatorOverhead);
+    addVector(m_events, usage.instanceState, usage.allocatorOverhead);
+    for (const std::vector<AnimationEvent> &events: m_chunkEvents) {
+        addVector(events, usage.instanceState, usage.allocatorOverhead);
+    }
+    for (const std::vector<RenderRecord> &records: m_frames) {
+        addVector(records, usage.instanceState, usage.allocatorOverhead);
+    }
+    for (const RenderBatch &batch: m_batches) {
+        addVector(batch.vertices, usage.instanceState, usage.allocatorOverhead);
+        addVector(batch.quads, usage.instanceState, usage.allocatorOverhead);
+    }
+    for (const std::vector<sf::Vertex> &vertices: m_drawBuffers) {
+        addVector(vertices, usage.instanceState, usage.allocatorOverhead);
+    }
+    return usage;
+}
+
+AnimationContext::MemoryUsage AnimationContext::getMemoryUsage(const std::string &animation) {
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    MemoryUsage usage;
+    const int clipId = m_clipIds.find(animation);
+    if (clipId < 0) {
+        // Output an error message if no animation entry is found
+        addStat(LookupMissesCounter, 1);
+        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+        return usage;
+    }
+
+    // Add the animation's entries and its clip, then the state of the instances playing it
+    addAnimationMemory(animation, usage);
+    usage.clipMetadata += sizeof(ClipLayout) + sizeof(std::atomic<bool>) + sizeof(std::atomic<int>);
+    const std::size_t bytes = instanceBytes();
+    for (const int instanceClip: m_instanceClips) {
+        if (instanceClip == clipId) {
+            usage.instanceState += bytes;
+        }
+    }
+    return usage;
+}
+
+void AnimationContext::addAnimationMemory(const std::string &animation, MemoryUsage &usage) {
+    // The name is a key of every property map the animation has an entry in, and of the registry
+    std::size_t &names = usage.nameStorage;
+    std::size_t &overhead = usage.allocatorOverhead;
+    addMapEntry(m_startingIndices, animation, names, overhead);
+    addMapEntry(m_endingIndices, animation, names, overhead);
+    addMapEntry(m_sheetSizes, animation, names, overhead);
+    addMapEntry(m_spriteSizes, animation, names, overhead);
+    addMapEntry(m_frequencies, animation, names, overhead);
+    addMapEntry(m_playbackModes, animation, names, overhead);
+    usage.clipMetadata += 4 * sizeof(sf::Vector2i) + sizeof(int) + sizeof(PlaybackMode);
+    if (m_clipIds.find(animation) >= 0) {
+        const std::size_t heap = stringHeapBytes(animation);
+        names += sizeof(std::string) + heap;
+        overhead += MapNodeLinks + AllocationOverhead + (heap > 0 ? AllocationOverhead : 0);
+        usage.clipMetadata += sizeof(int);
+    }
+
+    // The texture's pixels and object, and the block holding it with the shared pointer's reference counts
+    if (addMapEntry(m_textures, animation, names, overhead)) {
+        const sf::Vector2u size = m_textures[animation]->getSize();
+        usage.texturePixels += static_cast<std::size_t>(size.x) * size.y * 4;
+        usage.clipMetadata += sizeof(std::shared_ptr<sf::Texture>) + sizeof(sf::Texture);
+        overhead += SharedBlockOverhead;
+    }
+
+    // Frame durations and marked frames
+    auto timing = m_frameEndTimes.find(animation);
+    if (addMapEntry(m_frameEndTimes, animation, names, overhead)) {
+        usage.clipMetadata += sizeof(std::vector<int>);
+        addVector(timing->second, usage.frameTables, overhead);
+    }
+    auto markers = m_markers.find(animation);
+    if (addMapEntry(m_markers, animation, names, overhead)) {
+        usage.clipMetadata += sizeof(std::vector<std::pair<int, int>>);
+        addVector(markers->second, usage.frameTables, overhead);
+    }
+}
+
+std::size_t AnimationContext::instanceBytes() const {
+    // One element of every instance array, a slot in the active set and a record in the published frame
+    return 15 * sizeof(int) + (2 + StateMachineParameters) * sizeof(float) + 2 * sizeof(sf::IntRect) +
+           2 * sizeof(sf::Vector2f) + 2 * sizeof(unsigned char) + sizeof(RenderRecord);
+}
+
+AnimationContext::Stats AnimationContext::getStats() const {
+    // Sum the blocks of all thread slots
+    long long totals[StatCounters] = {};
+    for (const StatBlock &block: m_statBlocks) {
+        for (int counter = 0; counter < StatCounters; ++counter) {
+            totals[counter] += block.counters[counter].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Report what was counted since the last reset
+    Stats stats;
+    stats.updates = totals[UpdatesCounter] - m_statsBaseline.updates;
+    stats.instancesUpdated = totals[InstancesUpdatedCounter] - m_statsBaseline.instancesUpdated;
+    stats.framesAdvanced = totals[FramesAdvancedCounter] - m_statsBaseline.framesAdvanced;
+    stats.eventsEmitted = totals[EventsEmittedCounter] - m_statsBaseline.eventsEmitted;
+    stats.commandsRun = totals[CommandsRunCounter] - m_statsBaseline.commandsRun;
+    stats.lookupMisses = totals[LookupMissesCounter] - m_statsBaseline.lookupMisses;
+    stats.instancesDeferred = totals[InstancesDeferredCounter] - m_statsBaseline.instancesDeferred;
+    stats.framesDrawn = totals[FramesDrawnCounter] - m_statsBaseline.framesDrawn;
+    stats.drawCalls = totals[DrawCallsCounter] - m_statsBaseline.drawCalls;
+    stats.textureSwitches = totals[TextureSwitchesCounter] - m_statsBaseline.textureSwitches;
+    stats.verticesSubmitted = totals[VerticesSubmittedCounter] - m_statsBaseline.verticesSubmitted;
+    stats.textureBreaks = totals[TextureBreaksCounter] - m_statsBaseline.textureBreaks;
+    stats.bufferBreaks = totals[BufferBreaksCounter] - m_statsBaseline.bufferBreaks;
+    return stats;
+}
+
+void AnimationContext::resetStats() {
+    // Keep counting, but report from the current totals on, so threads never have to see a counter cleared
+    const Stats stats = getStats();
+    m_statsBaseline.updates += stats.updates;
+    m_statsBaseline.instancesUpdated += stats.instancesUpdated;
+    m_statsBaseline.framesAdvanced += stats.framesAdvanced;
+    m_statsBaseline.eventsEmitted += stats.eventsEmitted;
+    m_statsBaseline.commandsRun += stats.commandsRun;
+    m_statsBaseline.lookupMisses += stats.lookupMisses;
+    m_statsBaseline.instancesDeferred += stats.instancesDeferred;
+    m_statsBaseline.framesDrawn += stats.framesDrawn;
+    m_statsBaseline.drawCalls += stats.drawCalls;
+    m_statsBaseline.textureSwitches += stats.textureSwitches;
+    m_statsBaseline.verticesSubmitted += stats.verticesSubmitted;
+    m_statsBaseline.textureBreaks += stats.textureBreaks;
+    m_statsBaseline.bufferBreaks += stats.bufferBreaks;
+}
+
+AnimationContext::DrawStats AnimationContext::getFrameDrawStats() const {
+    return m_frameDrawStats;
+}
+
+int AnimationContext::addStateMachine(const AnimationStateMachine &stateMachine) {
+    const int stateCount = static_cast<int>(stateMachine.m_animations.size());
+    if (stateCount == 0 || stateMachine.m_initialState < 0 || stateMachine.m_initialState >= stateCount ||
+        stateMachine.m_parameterValues.size() > static_cast<std::size_t>(StateMachineParameters)) {
+        // Output an error message if the state machine cannot be compiled
+        std::cerr << "Invalid animation state machine!" << std::endl;
+        return -1;
+    }
+
+    // Resolve the animation of every state once, so switching states needs no string lookups
+    std::lock_guard<std::mutex> lock(m_animationMutex);
+    std::vector<int> clips;
+    for (const std::string &animation: stateMachine.m_animations) {
+        const int clipId = m_clipIds.find(animation);
+        if (clipId < 0) {
+            // Output an error message if no animation entry is found
+            addStat(LookupMissesCounter, 1);
+            std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
+            return -1;
+        }
+        clips.push_back(clipId);
+    }
+
+    // Append the states, each followed by its transitions in the order they were added
+    const int firstState = static_cast<int>(m_stateClips.size());
+    for (int state = 0; state < stateCount; ++state) {
+        m_stateClips.push_back(clips[state]);
+        m_stateModes.push_back(static_cast<int>(stateMachine.m_modes[state]));
+        m_stateBlends.push_back(stateMachine.m_blends[state]);
+        m_stateTransitionBegins.push_back(static_cast<int>(m_transitions.size()));
+        for (const AnimationStateMachine::Transition &transition: stateMachine.m_transitions) {
+            if (transition.from == state && transition.to >= 0 && transition.to < stateCount &&
+                transition.parameter >= 0 && transition.parameter < StateMachineParameters) {
+                const int marker = transition.condition == AnimationStateMachine::Condition::Marker
+                                       ? markerId(transition.marker)
+                                       : -1;
+                m_transitions.push_back({static_cast<int>(transition.condition), transition.parameter,
+                                         transition.threshold, marker, firstState + transition.to});
+            }
+        }
+        m_stateTransitionEnds.push_back(static_cast<int>(m_transitions.size()));
+    }
+
+    // Store the initial state and parameters used by new instances
+    m_machineFirstStates.push_back(firstState);
+    m_machineInitialStates.push_back(firstState + stateMachine.m_initialState);
+    const std::size_t parameters = m_machineParameters.size();
+    m_machineParameters.resize(parameters + StateMachineParameters, 0.f);
+    std::copy(stateMachine.m_parameterValues.begin(), stateMachine.m_parameterValues.end(),
+              m_machineParameters.begin() + static_cast<std::ptrdiff_t>(parameters));
+    return static_cast<int>(m_machineFirstStates.size()) - 1;
+}
+
+int AnimationContext::createStateMachineInstance(int stateMachine) {
+    if (stateMachine < 0 || stateMachine >= static_cast<int>(m_machineFirstStates.size())) {
+        // Output an error message if the id does not refer to a state machine
+        std::cerr << "No animation state machine " << stateMachine << "!" << std::endl;
+        return -1;
+    }
+
+    // Copy the initial parameters and register the instance with the state machine pass
+    const int instance = allocateInstance();
+    if (instance < 0) {
+        return -1;
+    }
+    std::copy_n(m_machineParameters.begin() + stateMachine * StateMachineParameters, StateMachineParameters,
+                m_instanceParameters.begin() + instance * StateMachineParameters);
+    m_instanceMachines[instance] = stateMachine;
+    m_instanceMachineSlots[instance] = static_cast<int>(m_machineInstances.size());
+    m_machineInstances.push_back(instance);
+
+    // Start the instance in the initial state
+    enterState(instance, m_machineInitialStates[stateMachine]);
+    return instanceHandle(instance);
+}
+
+void AnimationContext::setInstanceParameter(int handle, int parameter, float value) {
+    const int instance = instanceFromHandle(handle);
+    if (instance < 0 || m_instanceMachines[instance] < 0 || parameter < 0 || parameter >= StateMachineParameters) {
+        return; // Nothing to set
+    }
+
+    // Set the parameter, which is checked by the next updateAll
+    m_instanceParameters[instance * StateMachineParameters + parameter] = value;
+}
+
+int AnimationContext::getInstanceState(int handle) {
+    const int instance = instanceFromHandle(handle);
+    if (instance < 0 || m_instanceMachines[instance] < 0) {
+        return -1; // The instance has no state machine
+    }
+
+    // Convert the state back to its index within the state machine
+    return m_instanceStates[instance] - m_machineFirstStates[m_instanceMachines[instance]];
+}
+
+void AnimationContext::drainEvents(std::vector<AnimationEvent> &events) {
+    ANIMATION_TRACE_SCOPE("drainEvents");
+
+    // Swap buffers so neither side has to reallocate once both have grown, giving the caller's buffer the room
+    // the update keeps for events the first time it comes back
+    events.clear();
+    events.swap(m_events);
+    m_events.reserve(m_instanceClips.capacity() * ReservedEventsPerInstance);
+}
+
+void AnimationContext::refreshClip(const std::string &animation) {
+    // Only animations added with addAnimation have a clip id
+    const int clipId = m_clipIds.find(animation);
+    if (clipId >= 0) {
+        refreshClip(animation, clipLayout(clipId));
+    }
+}
+
+void AnimationContext::refreshClip(const std::string &animation, ClipLayout &clip) {
+    // Copy the sheet layout, treating the default ending index (the sheet size) as the last frame
+    const sf::Vector2i sheetSize = m_sheetSizes[animation];
+    const sf::Vector2i start = m_startingIndices[animation];
+    const sf::Vector2i end = m_endingIndices[animation];
+    const int sheetFrames = std::max(sheetSize.x * sheetSize.y, 1);
+    clip.texture = m_textures[animation].get();
+    clip.spriteSize = m_spriteSizes[animation];
+    clip.sheetRows = std::max(sheetSize.y, 1);
+    clip.firstFrame = std::clamp(start.x * clip.sheetRows + start.y, 0, sheetFrames - 1);
+    clip.frameSpan = sheetFrames - clip.firstFrame;
+    clip.frameTicks = std::max(m_frequencies[animation], 1);
+    clip.mode = m_playbackModes[animation];
+    auto markers = m_markers.find(animation);
+    clip.markers = markers != m_markers.end() ? &markers->second : nullptr;
+
+    // Timed animations take their length from the prefix sums, uniform ones from the ending index
+    auto timing = m_frameEndTimes.find(animation);
+    int firstDuration, lastDuration;
+    if (timing != m_frameEndTimes.end()) {
+        const std::vector<int> &frameEndTimes = timing->second;
+        clip.frameEndTimes = &frameEndTimes;
+        clip.frameCount = static_cast<int>(frameEndTimes.size());
+        clip.duration = frameEndTimes.back();
+        firstDuration = frameEndTimes.front();
+        lastDuration = clip.frameCount > 1 ? clip.duration - frameEndTimes[clip.frameCount - 2] : clip.duration;
+    } else {
+        const int lastFrame = std::clamp(end.x * clip.sheetRows + end.y, clip.firstFrame, sheetFrames - 1);
+        clip.frameEndTimes = nullptr;
+        clip.frameCount = lastFrame - clip.firstFrame + 1;
+        clip.duration = clip.frameCount * clip.frameTicks;
+        firstDuration = lastDuration = clip.frameTicks;
+    }
+
+    // Fill in the constants of each playback mode: {cap, wrap, last, fold, mirror, reverse}
+    const int forever = std::numeric_limits<int>::max();
+    const int duration = clip.duration;
+    clip.playback[static_cast<int>(PlaybackMode::Loop)] = {forever, duration, duration - 1, duration, 0, 0};
+    clip.playback[static_cast<int>(PlaybackMode::Once)] = {duration, duration + 1, duration - 1, duration, 0, 0};
+    clip.playback[static_cast<int>(PlaybackMode::OnceRelease)] = clip.playback[static_cast<int>(PlaybackMode::Once)];
+    clip.playback[static_cast<int>(PlaybackMode::Reverse)] = {forever, duration, duration - 1, duration, 0, 1};
+    if (clip.frameCount > 1) {
+        // Going back skips the last and first frames so neither is shown twice in a row
+        const int period = 2 * duration - firstDuration - lastDuration;
+        clip.playback[static_cast<int>(PlaybackMode::PingPong)] =
+                {forever, period, period - 1, duration, period + firstDuration - 1, 0};
+    } else {
+        clip.playback[static_cast<int>(PlaybackMode::PingPong)] = clip.playback[static_cast<int>(PlaybackMode::Loop)];
+    }
+}
+
+int AnimationContext::advanceTime(const PlaybackParams &params, int time, int calls) {
+    // Looping modes wrap around, one-shot modes stop at their cap
+    const long long advanced = std::min(static_cast<long long>(time) + calls, static_cast<long long>(params.cap));
+    return static_cast<int>(advanced % params.wrap);
+}
+
+int AnimationContext::sampleFrame(const ClipLayout &clip, const PlaybackParams &params, int time) {
+    // Clamp, fold and mirror the time with arithmetic instead of branching on the playback mode
+    int sampled = std::min(time, params.last);
+    const int turned = sampled >= params.fold;
+    sampled += turned * (params.mirror - 2 * sampled);
+    sampled += params.reverse * (clip.duration - 1 - 2 * sampled);
+
+    // Uniform animations index the frame directly, timed ones search the prefix sums
+    if (!clip.frameEndTimes) {
+        return sampled / clip.frameTicks;
+    }
+    const std::vector<int> &frameEndTimes = *clip.frameEndTimes;
+    return static_cast<int>(std::upper_bound(frameEndTimes.begin(), frameEndTimes.end(), sampled) -
+                            frameEndTimes.begin());
+}
+
+sf::Vector2i AnimationContext::frameIndex(const ClipLayout &clip, int frame) {
+    // Frames run down each column of the sheet before moving to the next one
+    const int linear = clip.firstFrame + frame % clip.frameSpan;
+    return {linear / clip.sheetRows, linear % clip.sheetRows};
+}
+
+sf::IntRect AnimationContext::frameRect(const ClipLayout &clip, int frame) {
+    // Calculate the texture rectangle of the frame
+    const sf::Vector2i index = frameIndex(clip, frame);
+    return {{index.x * clip.spriteSize.x, index.y * clip.spriteSize.y}, clip.spriteSize};
+}
+
+int AnimationContext::frameStartTime(const ClipLayout &clip, int frame) {
+    // The prefix sums hold the end of each frame, which is the start of the next one
+    if (frame <= 0) {
+        return 0;
+    }
+    return clip.frameEndTimes ? (*clip.frameEndTimes)[frame - 1] : frame * clip.frameTicks;
+}
+
+int AnimationContext::markerId(const std::string &marker) {
+    // Give each marker name an id, leaving 0 for FinishedMarker
+    auto id = m_markerIds.find(marker);
+    if (id == m_markerIds.end()) {
+        id = m_markerIds.emplace(marker, static_cast<int>(m_markerIds.size()) + 1).first;
+    }
+    return id->second;
+}
+
+int AnimationContext::allocateInstance() {
+    // Reuse a free handle, resetting what the previous instance set
+    if (!m_freeInstances.empty()) {
+        const int instance = m_freeInstances.back();
+        m_freeInstances.pop_back();
+        resetInstance(instance);
+        addLiveInstance(instance);
+        return instance;
+    }
+
+    // Take the next index from the counter shared with queueSpawn and grow the instance arrays
+    const int instance = m_nextInstance.fetch_add(1);
+    if (instance >= MaxInstances) {
+        // Output an error message if the handles have no room for the index
+        std::cerr << "No more than " << MaxInstances << " animation instances!" << std::endl;
+        return -1;
+    }
+    resizeInstances(instance + 1);
+    addLiveInstance(instance);
+    return instance;
+}
+
+void AnimationContext::resetInstance(int instance) {
+    // Restore the defaults of the settings an instance keeps while it plays
+    m_instanceSpeeds[instance] = 1.f;
+    m_instanceCarries[instance] = 0.f;
+    m_instancePositions[instance] = {0.f, 0.f};
+    m_instanceScales[instance] = {1.f, 1.f};
+    m_instanceVisible[instance] = 1;
+    m_instanceFadeTimes[instance] = 0;
+    m_instancePriorities[instance] = 0;
+}
+
+void AnimationContext::resizeInstances(int count) {
+    // Grow every instance array, leaving the new slots free until they are set up
+    if (count <= static_cast<int>(m_instanceClips.size())) {
+        return;
+    }
+    const auto size = static_cast<std::size_t>(count);
+    m_instanceClips.resize(size, -1);
+    m_instanceModes.resize(size, 0);
+    m_instanceTimes.resize(size, 0);
+    m_instanceSpeeds.resize(size, 1.f);
+    m_instanceCarries.resize(size, 0.f);
+    m_instanceFrames.resize(size, 0);
+    m_instanceRects.resize(size);
+    m_instanceActiveSlots.resize(size, -1);
+    m_instanceLiveSlots.resize(size, -1);
+    m_instanceFirstEvents.resize(size, -1);
+    m_instanceMachines.resize(size, -1);
+    m_instanceStates.resize(size, -1);
+    m_instanceParameters.resize(size * StateMachineParameters, 0.f);
+    m_instanceMachineSlots.resize(size, -1);
+    m_instancePositions.resize(size, {0.f, 0.f});
+    m_instanceScales.resize(size, {1.f, 1.f});
+    m_instanceVisible.resize(size, 1);
+    m_instanceFadeClips.resize(size, -1);
+    m_instanceFadeRects.resize(size);
+    m_instanceFadeTimes.resize(size, 0);
+    m_instanceFadeDurations.resize(size, 1);
+    m_instancePriorities.resize(size, 0);
+    m_instanceUpdateTicks.resize(size, 0);
+    m_instanceGenerations.resize(size, 0);
+
+    // Make room for every handle in the free and live lists, and for a burst of events from every instance, now,
+    // so none of them allocates during updateAll
+    m_freeInstances.reserve(m_instanceClips.capacity());
+    m_liveInstances.reserve(m_instanceClips.capacity());
+    m_events.reserve(m_instanceClips.capacity() * ReservedEventsPerInstance);
+}
+
+void AnimationContext::spawnInstance(int instance, int clip, int mode) {
+    // Start the instance on the first frame of the clip
+    m_instanceClips[instance] = clip;
+    m_instanceModes[instance] = mode;
+    restartInstanceAt(instance);
+}
+
+void AnimationContext::executeCommands() {
+    ANIMATION_PROFILE_SCOPE(Commands);
+    ANIMATION_TRACE_SCOPE("commands");
+
+    // Run every command posted so far, in order
+    AnimationCommand command;
+    while (m_commands.pop(command)) {
+        runCommand(command);
+    }
+
+    // Merge what each worker spawned and destroyed through its shard before this point, in the order the
+    // worker did it; later commands wait for the next update, so a busy worker cannot keep the merge going
+    for (const std::unique_ptr<AnimationSpawnShard> &shard: m_shards) {
+        for (std::size_t pending = shard->m_commands.size(); pending > 0 && shard->m_commands.pop(command); --pending) {
+            runCommand(command);
+        }
+
+        // Top up the shard with freed handles to half its capacity, so its short-lived instances keep reusing them
+        // while the rest stay in the free list for the other shards and createInstance
+        const std::size_t lowWater = shard->m_handles.capacity() / 2;
+        for (std::size_t held = shard->m_handles.size(); held < lowWater && !m_freeInstances.empty(); ++held) {
+            shard->m_handles.push(instanceHandle(m_freeInstances.back()));
+            m_freeInstances.pop_back();
+        }
+    }
+}
+
+void AnimationContext::runCommand(const AnimationCommand &command) {
+    addStat(CommandsRunCounter, 1);
+    switch (command.type) {
+        case AnimationCommand::Type::Play:
+            restartInstance(command.instance);
+            break;
+        case AnimationCommand::Type::Stop:
+            stopInstance(command.instance);
+            break;
+        case AnimationCommand::Type::Seek:
+            seekInstance(command.instance, command.value);
+            break;
+        case AnimationCommand::Type::SetSpeed:
+            setInstanceSpeed(command.instance, command.speed);
+            break;
+        case AnimationCommand::Type::Spawn: {
+            // The handle was reserved by queueSpawn or a shard, so its index may not exist yet or may be reused; a
+            // reused index keeps the generation it was handed out under, and a new one starts at generation 0
+            if (command.instance < 0) {
+                addStat(LookupMissesCounter, 1);
+                break; // Reserved past the most instances a context holds
+            }
+            const int instance = command.instance & (MaxInstances - 1);
+            resizeInstances(instance + 1);
+            if (command.value >= 0 && command.value < m_clipCount.load() &&
+                m_clipChunks[command.value / ClipChunkSize]->live[command.value % ClipChunkSize].load()) {
+                resetInstance(instance);
+                addLiveInstance(instance);
+                spawnInstance(instance, command.value, command.mode);
+            } else {
+                addStat(LookupMissesCounter, 1);
+                recycleInstance(instance); // Give the unused index back, so commands sent with the handle are dropped
+            }
+            break;
+        }
+        case AnimationCommand::Type::Destroy:
+            destroyInstance(command.instance);
+            break;
+    }
+}
+
+AnimationSpawnShard &AnimationContext::createSpawnShard(std::size_t capacity) {
+    // Keep the shard for the lifetime of the context, so workers can hold on to it
+    m_shards.emplace_back(new AnimationSpawnShard(m_nextInstance, capacity));
+    return *m_shards.back();
+}
+
+void AnimationContext::enterState(int instance, int state) {
+    // Switch the instance to the state's animation and playback mode
+    beginCrossfade(instance, m_stateBlends[state]);
+    m_instanceStates[instance] = state;
+    m_instanceClips[instance] = m_stateClips[state];
+    m_instanceModes[instance] = m_stateModes[state];
+
+    // A one-shot state that finished and moved on must not be dropped from the active set
+    const int slot = m_instanceActiveSlots[instance];
+    if (slot >= 0 && slot < static_cast<int>(m_activeFinished.size())) {
+        m_activeFinished[slot] = 0;
+    }
+    restartInstanceAt(instance);
+}
+
+void AnimationContext::publishFrame() {
+    ANIMATION_PROFILE_SCOPE(Publish);
+    ANIMATION_TRACE_SCOPE("publish");
+
+    // Write a record for every visible live instance into the back buffer, reusing its memory; walking the
+    // live set keeps publishing proportional to the instances that exist, not to the most there ever were
+    std::vector<RenderRecord> &records = m_frames[m_backFrame];
+    records.clear();
+    for (const int instance: m_liveInstances) {
+        if (!m_instanceVisible[instance]) {
+            continue;
+        }
+        const int fadeTime = m_instanceFadeTimes[instance];
+        RenderRecord record{clipLayout(m_instanceClips[instance]).texture, m_instanceRects[instance], nullptr, {}, 1.f,
+                            m_instancePositions[instance], m_instanceScales[instance]};
+        if (fadeTime > 0) {
+            record.fadeTexture = clipLayout(m_instanceFadeClips[instance]).texture;
+            record.fadeRect = m_instanceFadeRects[instance];
+            record.weight = 1.f - static_cast<float>(fadeTime) / static_cast<float>(m_instanceFadeDurations[instance]);
+        }
+        records.push_back(record);
+    }
+
+    // Publish the back buffer and take over the buffer that was ready before
+    m_backFrame = m_readyFrame.exchange(m_backFrame | NewFrame, std::memory_order_acq_rel) & ~NewFrame;
+}
+
+void AnimationContext::beginCrossfade(int instance, int duration) {
+    // Remember the current frame so drawAll can fade it out (new instances have nothing to fade out of)
+    const int clip = m_instanceClips[instance];
+    m_instanceFadeTimes[instance] = clip >= 0 ? std::max(duration, 0) : 0;
+    m_instanceFadeDurations[instance] = std::max(duration, 1);
+    m_instanceFadeClips[instance] = clip;
+    m_instanceFadeRects[instance] = m_instanceRects[instance];
+}
+
+std::vector<sf::Vertex> &AnimationContext::batchVertices(const sf::Texture *texture) {
+    return findBatch(texture).vertices;
+}
+
+AnimationContext::RenderBatch &AnimationContext::findBatch(const sf::Texture *texture) {
+    // Find the batch of the texture, adding one the first time the texture is drawn
+    for (RenderBatch &batch: m_batches) {
+        if (batch.texture == texture) {
+            return batch;
+        }
+    }
+    m_batches.push_back({texture, {}, {}});
+    return m_batches.back();
+}
+
+void AnimationContext::takeFrame() {
+    // Take the latest published frame, keeping the current one if nothing new was published
+    if (m_readyFrame.load(std::memory_order_acquire) & NewFrame) {
+        m_frontFrame = m_readyFrame.exchange(m_frontFrame, std::memory_order_acq_rel) & ~NewFrame;
+    }
+
+    // Empty the batches while keeping their memory
+    for (RenderBatch &batch: m_batches) {
+        batch.vertices.clear();
+        batch.quads.clear();
+    }
+}
+
+void AnimationContext::generateSegments() {
+    using Clock = std::chrono::steady_clock;
+    long long frame = 0;
+    for (;;) {
+        // Sleep until drawAllPipelined hands over the next frame or the context is destroyed
+        {
+            std::unique_lock<std::mutex> lock(m_drawMutex);
+            m_drawWake.wait(lock, [&] { return m_drawStopping || m_drawFrames != frame; });
+            if (m_drawStopping) {
+                return;
+            }
+            frame = m_drawFrames;
+        }
+
+        // Generate the segments in order, each once the buffer it goes into has been drawn. Nothing of the
+        // frame is read after the last segment is handed over, as the next frame may already be set up then.
+        const std::vector<RenderRecord> &records = m_frames[m_frontFrame];
+        const int segments = static_cast<int>(m_drawSegments.size());
+        for (int segment = 0; segment < segments; ++segment) {
+            while (segment - m_segmentsDrawn.load(std::memory_order_acquire) >= DrawBuffers) {
+                std::this_thread::yield();
+            }
+            ANIMATION_TRACE_SCOPE("generateSegment");
+            const Clock::time_point start = Clock::now();
+            const DrawSegment &range = m_drawSegments[segment];
+            const std::vector<int> &quads = m_batches[range.batch].quads;
+            std::vector<sf::Vertex> &vertices = m_drawBuffers[segment % DrawBuffers];
+            vertices.clear();
+            for (int quad = range.begin; quad < range.end; ++quad) {
+                const RenderRecord &record = records[quads[quad] / 2];
+                if (quads[quad] % 2) {
+                    appendQuad(vertices, record.position, record.scale, record.fadeRect,
+                               static_cast<std::uint8_t>(255.f * (1.f - record.weight)));
+                } else {
+                    appendQuad(vertices, record.position, record.scale, record.rect,
+                               static_cast<std::uint8_t>(255.f * record.weight));
+                }
+            }
+            m_generateMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            m_segmentsGenerated.store(segment + 1, std::memory_order_release);
+        }
+    }
+}
+
+void AnimationContext::appendQuad(std::vector<sf::Vertex> &vertices, sf::Vector2f position, sf::Vector2f scale,
+                                  const sf::IntRect &rect, std::uint8_t alpha) {
+    // Calculate the corners of the quad on screen and in the texture
+    const sf::Vector2f size(static_cast<float>(rect.size.x) * scale.x, static_cast<float>(rect.size.y) * scale.y);
+    const sf::Vector2f texLeftTop(static_cast<float>(rect.position.x), static_cast<float>(rect.position.y));
+    const sf::Vector2f texRightBottom(texLeftTop.x + static_cast<float>(rect.size.x),
+                                      texLeftTop.y + static_cast<float>(rect.size.y));
+    const sf::Color color(255, 255, 255, alpha);
+    const sf::Vertex leftTop{position, color, texLeftTop};
+    const sf::Vertex rightTop{{position.x + size.x, position.y}, color, {texRightBottom.x, texLeftTop.y}};
+    const sf::Vertex leftBottom{{position.x, position.y + size.y}, color, {texLeftTop.x, texRightBottom.y}};
+    const sf::Vertex rightBottom{position + size, color, texRightBottom};
+
+    // Append the quad as two triangles
+    vertices.push_back(leftTop);
+    vertices.push_back(rightTop);
+    vertices.push_back(leftBottom);
+    vertices.push_back(leftBottom);
+    vertices.push_back(rightTop);
+    vertices.push_back(rightBottom);
+}
+
+void AnimationContext::activateInstance(int instance) {
+    // Append the instance to the active set if it is not already there
+    if (m_instanceActiveSlots[instance] < 0) {
+        m_instanceActiveSlots[instance] = static_cast<int>(m_activeInstances.size());
+        m_activeInstances.push_back(instance);
+        m_instanceUpdateTicks[instance] = m_budgetTick; // Owes no budgeted update yet
+    }
+}
+
+void AnimationContext::deactivateInstance(int instance) {
+    // Fill the instance's slot with the last active instance to keep the active set dense
+    const int slot = m_instanceActiveSlots[instance];
+    if (slot >= 0) {
+        const int moved = m_activeInstances.back();
+        m_activeInstances[slot] = moved;
+        m_instanceActiveSlots[moved] = slot;
+        m_activeInstances.pop_back();
+        m_instanceActiveSlots[instance] = -1;
+    }
+
+    // End any crossfade, as only the kernel counts it down and an instance held on its frame is not advanced
+    m_instanceFadeTimes[instance] = 0;
+}
+
+void AnimationContext::addLiveInstance(int instance) {
+    // Append the instance to the live set if it is not already there
+    if (m_instanceLiveSlots[instance] < 0) {
+        m_instanceLiveSlots[instance] = static_cast<int>(m_liveInstances.size());
+        m_liveInstances.push_back(instance);
+    }
+}
+
+void AnimationContext::removeLiveInstance(int instance) {
+    // Fill the instance's slot with the last live instance to keep the live set dense
+    const int slot = m_instanceLiveSlots[instance];
+    if (slot >= 0) {
+        const int moved = m_liveInstances.back();
+        m_liveInstances[slot] = moved;
+        m_instanceLiveSlots[moved] = slot;
+        m_liveInstances.pop_back();
+        m_instanceLiveSlots[instance] = -1;
+    }
+}
@@ -0,0 +1,639 @@
+#pragma once
+#include "AnimationClipRegistry.h"
+#include "AnimationCommandQueue.h"
+#include "AnimationJobSystem.h"
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// This header file defines the AnimationContext class, which holds one independent set of
+// animations, instances and state machines. The class provides functions to:
+// - Add, update, and delete animations.
+// - Set various animation properties such as frequency, sprite size, sheet size, and indices.
+// - Give individual frames their own durations and seek to any point in an animation.
+// - Play animations once, looped, ping-ponged or reversed.
+// - Create many independent instances of an animation and update them all in one call.
+// - Mark frames of an animation and collect the markers reached by instances as a batch of events.
+// - Drive instances with state machines compiled into flat transition tables.
+// - Crossfade instances between animations and draw all instances in one call per texture.
+// - Control instances from other threads through a lock-free command queue.
+// - Spawn and destroy instances from worker threads through per-thread shards merged by updateAll.
+// - Draw on another thread than the one updating, from triple-buffered frame records.
+// - Generate the vertices of the next batch on a worker while the current one is drawn.
+// - Spread updateAll over worker threads through a work-stealing job system.
+// - Add animations from a streaming thread while instances are created and updated, a chunk at a time.
+// - Count updated instances, advanced frames, events and misses without contention between threads.
+// - Report the memory used by textures, clips, frame tables, instances and names.
+// - Update instances in priority order within a time budget, catching deferred ones up later.
+// Contexts share nothing, so each scene or worker thread can own one and update it without
+// synchronisation, and destroying a context releases all of its animations at once.
+// AnimationManager provides the same functions as static members working on a default context.
+
+class AnimationStateMachine;
+class AnimationSpawnShard;
+
+class AnimationContext {
+public:
+    // Ways an animation can play through its frames
+    enum class PlaybackMode {
+        Loop,        // Start over from the first frame after the last one
+        Once,        // Play through once and hold the last frame
+        OnceRelease, // Play through once and release the instance
+        PingPong,    // Play forwards then backwards without repeating the end frames
+        Reverse      // Loop from the last frame back to the first
+    };
+
+    // Record of a marker reached by an instance during updateAll
+    struct AnimationEvent {
+        int instance; // Handle of the instance
+        int marker;   // Id of the marker, FinishedMarker when a one-shot instance finished or DestroyedMarker
+    };
+
+    // Marker id of the event recorded when a one-shot instance plays its last frame to the end
+    static const int FinishedMarker = 0;
+
+    // Marker id of the event recorded when an instance is destroyed or released, before its handle is reused
+    static const int DestroyedMarker = -1;
+
+    // Bits of an instance handle holding the instance's index, and the most instances a context holds. The bits
+    // above count how often the index was reused, so a handle kept after its instance was destroyed or released
+    // refers to nothing, and commands sent with it are dropped instead of reaching the index's next instance.
+    static const int InstanceIndexBits = 20;
+    static const int MaxInstances = 1 << InstanceIndexBits;
+
+    // Maximum number of parameters of a state machine
+    static const int StateMachineParameters = 8;
+
+    // Times accumulated by drawAllPipelined, to see how much vertex generation overlapped with drawing
+    struct DrawTimings {
+        double generateMilliseconds = 0.0; // Time the worker spent generating vertices
+        double submitMilliseconds = 0.0;   // Time spent in RenderTarget::draw
+        double stallMilliseconds = 0.0;    // Time drawing waited for the worker
+        double totalMilliseconds = 0.0;    // Time spent in drawAllPipelined
+        double overlapMilliseconds = 0.0;  // Time generation and drawing ran at once
+        long long frames = 0;              // Calls of drawAllPipelined
+        long long segments = 0;            // Vertex buffers generated and drawn
+    };
+
+    // Counters of a context's work, summed over the threads that did it
+    struct Stats {
+        long long updates = 0;          // Calls of updateAll
+        long long instancesUpdated = 0; // Instances advanced by the update kernel
+        long long framesAdvanced = 0;   // Instances the kernel moved to another frame
+        long long eventsEmitted = 0;    // Events recorded by the kernel, including finished events
+        long long commandsRun = 0;      // Commands merged from the queue and the spawn shards
+        long long lookupMisses = 0;     // Animation names and clip ids that were not found
+        long long instancesDeferred = 0; // Instances updateAllBudgeted left for a later update, once per update
+        long long framesDrawn = 0;      // Calls of drawAll and drawAllPipelined
+        long long drawCalls = 0;        // Calls of RenderTarget::draw made by them
+        long long textureSwitches = 0;  // Draw calls binding another texture than the call before
+        long long verticesSubmitted = 0; // Vertices passed to RenderTarget::draw
+        long long textureBreaks = 0;    // Batches ended because the next quads use another texture
+        long long bufferBreaks = 0;     // Batches ended because drawAllPipelined filled a vertex buffer
+    };
+
+    // Draw calls of one frame and why the quads were not drawn with fewer. All quads are drawn with the
+    // render states passed in and crossfades use vertex alpha, so batches never break on blend modes.
+    struct DrawStats {
+        int drawCalls = 0;             // Calls of RenderTarget::draw
+        int textureSwitches = 0;       // Draw calls binding another texture than the call before, the first included
+        long long verticesSubmitted = 0; // Vertices passed to RenderTarget::draw
+        int textureBreaks = 0;         // Batches ended because the next quads use another texture
+        int bufferBreaks = 0;          // Batches ended because drawAllPipelined filled a vertex buffer
+    };
+
+    // Bytes used by a context or one animation, by category. Heap bookkeeping is estimated, not measured.
+    struct MemoryUsage {
+        std::size_t texturePixels = 0;     // Pixels of the textures, at four bytes each
+        std::size_t clipMetadata = 0;      // Properties, flattened clips, texture objects and state machine tables
+        std::size_t frameTables = 0;       // Per-frame durations and marked frames
+        std::size_t instanceState = 0;     // Instance arrays, the active set and the event and drawing buffers
+        std::size_t nameStorage = 0;       // Animation and marker names, once for every map keyed by them
+        std::size_t allocatorOverhead = 0; // Map node links, heap block headers and unused vector capacity
+
+        // Function to get the sum of all categories
+        std::size_t total() const;
+    };
+
+    // Instances of one animation, counted for debugging views
+    struct ClipInstances {
+        std::string animation; // Name of the animation
+        int instances;         // Instances playing it
+        int active;            // Instances among them that updateAll advances; the others are asleep
+    };
+
+    // Parameters of one animation added by addAnimations, the same as those of addAnimation
+    struct AnimationDefinition {
+        std::string animation;              // Name of the animation
+        const sf::Texture *texture;         // Texture copied for the animation
+        sf::Vector2i sheetSize;             // Frames in each row and column of the sheet
+        sf::Vector2i spriteSize;            // Size of one frame
+        sf::Vector2i index = {0, 0};        // Index the animation starts at
+        int frequency = 0;                  // Update calls per frame
+        sf::Vector2i startingIndex = {0, 0}; // First index of the animation
+    };
+
+private:
+    // Counters kept per thread, in the order of the fields of Stats
+    enum StatCounter {
+        UpdatesCounter,
+        InstancesUpdatedCounter,
+        FramesAdvancedCounter,
+        EventsEmittedCounter,
+        CommandsRunCounter,
+        LookupMissesCounter,
+        InstancesDeferredCounter,
+        FramesDrawnCounter,
+        DrawCallsCounter,
+        TextureSwitchesCounter,
+        VerticesSubmittedCounter,
+        TextureBreaksCounter,
+        BufferBreaksCounter,
+        StatCounters
+    };
+
+    // Counters of the threads that share one block, alone on their cache line so threads never write to the
+    // same line. Each thread adds to the block of its own slot; only threads beyond StatBlocks share a block.
+    static const int StatBlocks = 16;
+    struct alignas(64) StatBlock {
+        std::atomic<long long> counters[StatCounters] = {};
+    };
+
+    // Per-mode constants that let a single branch-free formula handle every playback mode
+    struct PlaybackParams {
+        int cap;     // Time at which playback stops advancing
+        int wrap;    // Period after which the time wraps around
+        int last;    // Latest time that is sampled
+        int fold;    // Time at which playback turns around
+        int mirror;  // Maps a turned-around time back onto the frames
+        int reverse; // 1 when the frames are played from last to first
+    };
+
+    // Animation data flattened from the maps so instances can be updated without string lookups
+    struct ClipLayout {
+        const sf::Texture *texture;            // Texture of the animation
+        const std::vector<int> *frameEndTimes; // Prefix sums of frame durations, or nullptr if uniform
+        const std::vector<std::pair<int, int>> *markers; // Marked frames and marker ids, or nullptr if none
+        sf::Vector2i spriteSize;               // Size of one frame
+        int sheetRows;                         // Number of frames in each column of the sheet
+        int firstFrame;                        // Frame number of the starting index
+        int frameSpan;                         // Frames from the starting index to the end of the sheet
+        int frameCount;                        // Number of frames played
+        int frameTicks;                        // Update calls per frame for uniform animations
+        int duration;                          // Update calls for one pass through the frames
+        PlaybackMode mode;                     // Playback mode used by update and new instances
+        PlaybackParams playback[5];            // Constants for each playback mode
+    };
+
+    // Block of flattened animations, allocated once and never moved so other threads can add clips during updateAll
+    static const int ClipChunkSize = 256;               // Clips in each block
+    static const int MaxClipChunks = 1024;              // Most blocks, limiting a context to 262144 clips
+    struct ClipChunk {
+        ClipLayout clips[ClipChunkSize];                // Flattened animations by clip id within the block
+        std::atomic<bool> live[ClipChunkSize];          // Whether each clip belongs to an animation
+        std::atomic<int> elapsed[ClipChunkSize];        // Elapsed update calls of update() on each clip, which
+                                                        // gives its current index without a name-keyed map
+    };
+
+    // Transition of a compiled state machine
+    struct StateTransition {
+        int condition;   // AnimationStateMachine condition that triggers the transition
+        int parameter;   // Parameter compared by parameter transitions
+        float threshold; // Value the parameter is compared against
+        int marker;      // Marker id of marker transitions
+        int target;      // State entered by the transition
+    };
+
+    // Everything drawAll needs to draw one instance, written by updateAll
+    struct RenderRecord {
+        const sf::Texture *texture;     // Texture of the current frame
+        sf::IntRect rect;               // Texture rectangle of the current frame
+        const sf::Texture *fadeTexture; // Texture of the frame faded out of, or nullptr without a crossfade
+        sf::IntRect fadeRect;           // Texture rectangle of the frame faded out of
+        float weight;                   // Opacity of the current frame during a crossfade
+        sf::Vector2f position;          // Position of the instance
+        sf::Vector2f scale;             // Scale of the instance
+    };
+
+    // Vertices of all quads sharing a texture, drawn with a single call
+    struct RenderBatch {
+        const sf::Texture *texture;       // Texture of the quads
+        std::vector<sf::Vertex> vertices; // Two triangles per quad
+        std::vector<int> quads;           // Records of the quads for drawAllPipelined, times two plus one for fades
+    };
+
+    // Quads of one batch that drawAllPipelined generates into one buffer of the ring and draws with one call
+    struct DrawSegment {
+        int batch; // Batch the quads belong to
+        int begin; // First quad in the batch's list
+        int end;   // One past the last quad in the batch's list
+    };
+
+    // Member variables to store animation data
+    std::map<std::string, std::shared_ptr<sf::Texture>> m_textures; // Textures of animations, possibly shared
+    std::map<std::string, sf::Vector2i> m_startingIndices; // Starting indices of animations
+    std::map<std::string, sf::Vector2i> m_endingIndices; // Ending indices of animations
+    std::map<std::string, sf::Vector2i> m_sheetSizes;   // Sizes of animation sheets
+    std::map<std::string, sf::Vector2i> m_spriteSizes;  // Sizes of animation sprites
+    std::map<std::string, int> m_frequencies;           // Frequencies of updates
+    std::map<std::string, std::vector<int>> m_frameEndTimes; // Prefix sums of per-frame durations
+    std::map<std::string, PlaybackMode> m_playbackModes; // Playback modes of animations
+    std::map<std::string, std::vector<std::pair<int, int>>> m_markers; // Marked frames sorted by frame
+    std::map<std::string, int> m_markerIds;             // Ids of marker names
+
+    // Guards the maps above and the free clip ids, so animations can be added from another thread
+    std::mutex m_animationMutex;
+
+    // Member variables to store the flattened animations and their instances
+    AnimationClipRegistry m_clipIds;                    // Clip ids of animations, looked up without locks
+    std::unique_ptr<ClipChunk> m_clipChunks[MaxClipChunks]; // Blocks of flattened animations by clip id
+    std::atomic<int> m_clipCount{0};                    // Clip ids given out so far
+    std::vector<int> m_freeClips;                       // Clip ids of deleted animations
+    std::vector<int> m_instanceClips;                   // Clip ids of instances (-1 if free)
+    std::vector<int> m_instanceModes;                   // Playback modes of instances
+    std::vector<int> m_instanceTimes;                   // Elapsed update calls of instances
+    std::vector<float> m_instanceSpeeds;                // Update calls instances advance per updateAll
+    std::vector<float> m_instanceCarries;               // Fractions of an update call carried over
+    std::vector<int> m_instanceFrames;                  // Current frames of instances
+    std::vector<sf::IntRect> m_instanceRects;           // Current texture rectangles of instances
+    std::vector<int> m_instanceActiveSlots;             // Positions in the active set (-1 if inactive)
+    std::vector<int> m_activeInstances;                 // Instances advanced by updateAll
+    std::vector<unsigned char> m_activeFinished;        // Finished flags written by the update kernel
+    static const int InstanceGenerations = 1 << (31 - InstanceIndexBits); // Generations told apart before wrapping
+    std::vector<int> m_instanceGenerations;             // Times instances were freed, kept above the index in handles
+    std::vector<int> m_freeInstances;                   // Freed instances ready for reuse
+    std::vector<int> m_instanceLiveSlots;               // Positions in the live set (-1 if free)
+    std::vector<int> m_liveInstances;                   // Instances that exist, published by updateAll
+    std::atomic<int> m_nextInstance{0};                 // First instance never given out
+    AnimationCommandQueue m_commands;                   // Commands posted by other threads
+    std::vector<std::unique_ptr<AnimationSpawnShard>> m_shards; // Spawn shards of worker threads
+    std::vector<AnimationEvent> m_events;               // Events recorded since the last drain
+    static const int ReservedEventsPerInstance = 2;     // Events per instance the buffers keep room for
+    std::vector<int> m_instanceFirstEvents;             // First event of state machine instances this update (-1 if none)
+    std::vector<sf::Vector2f> m_instancePositions;      // Positions of instances drawn by drawAll
+    std::vector<sf::Vector2f> m_instanceScales;         // Scales of instances drawn by drawAll
+    std::vector<unsigned char> m_instanceVisible;       // Whether drawAll draws instances
+    std::vector<int> m_instanceFadeClips;               // Clip ids of the frames instances fade out of
+    std::vector<sf::IntRect> m_instanceFadeRects;       // Texture rectangles of the frames faded out of
+    std::vector<int> m_instanceFadeTimes;               // Update calls left in the crossfades
+    std::vector<int> m_instanceFadeDurations;           // Update calls of the whole crossfades
+    std::vector<RenderBatch> m_batches;                 // Vertices of drawAll, kept to reuse their memory
+
+    // Member variables of drawAllPipelined. The worker fills the buffers of the ring in segment order while
+    // the drawing thread draws them in the same order; the two counters tell each side which buffers it may use.
+    static const int DrawBuffers = 3;                   // Buffers in the ring
+    static const int SegmentQuads = 2048;               // Most quads generated into one buffer
+    std::vector<DrawSegment> m_drawSegments;            // Segments of the frame being drawn
+    std::vector<sf::Vertex> m_drawBuffers[DrawBuffers]; // Ring of vertex buffers, kept to reuse their memory
+    std::thread m_drawWorker;                           // Worker generating vertices, started on first use
+    std::mutex m_drawMutex;                             // Guards m_drawFrames and m_drawStopping
+    std::condition_variable m_drawWake;                 // Wakes the worker for a new frame
+    long long m_drawFrames = 0;                         // Frames handed to the worker so far
+    bool m_drawStopping = false;                        // Set when the context is destroyed
+    alignas(64) std::atomic<int> m_segmentsGenerated{0}; // Segments of the frame the worker has generated
+    alignas(64) std::atomic<int> m_segmentsDrawn{0};    // Segments of the frame that have been drawn
+    double m_generateMilliseconds = 0.0;                // Generation time of the frame, written by the worker
+    DrawTimings m_drawTimings;                          // Times accumulated over all frames
+    DrawStats m_frameDrawStats;                         // Draw calls of the latest frame drawn
+
+    // Member variables to hand frames from updateAll to drawAll. Each buffer is owned by one side
+    // at a time: updateAll fills its back buffer, then swaps it with the ready one, which drawAll takes.
+    std::vector<RenderRecord> m_frames[3];              // Frame records of the three buffers
+    int m_backFrame = 0;                                // Buffer owned by updateAll
+    int m_frontFrame = 1;                               // Buffer owned by drawAll
+    std::atomic<int> m_readyFrame{2};                   // Latest published buffer, plus NewFrame if unread
+    static const int NewFrame = 4;                      // Flag set in m_readyFrame by each publish
+
+    // Member variables to store the compiled state machines and the instances they drive
+    std::vector<int> m_stateClips;                      // Clip ids of states
+    std::vector<int> m_stateModes;                      // Playback modes of states
+    std::vector<int> m_stateBlends;                     // Crossfade durations into states
+    std::vector<int> m_stateTransitionBegins;           // First transition of each state
+    std::vector<int> m_stateTransitionEnds;             // One past the last transition of each state
+    std::vector<StateTransition> m_transitions;         // Transitions grouped by state
+    std::vector<int> m_machineFirstStates;              // First state of each state machine
+    std::vector<int> m_machineInitialStates;            // State new instances of a state machine enter
+    std::vector<float> m_machineParameters;             // Initial parameters of each state machine
+    std::vector<int> m_instanceMachines;                // State machines of instances (-1 if none)
+    std::vector<int> m_instanceStates;                  // Current states of instances (-1 if none)
+    std::vector<float> m_instanceParameters;            // State machine parameters of instances
+    std::vector<int> m_instanceMachineSlots;            // Positions in m_machineInstances (-1 if none)
+    std::vector<int> m_machineInstances;                // Instances driven by a state machine
+
+    // Member variables of the statistics, counted since the context was created and reported from the baseline
+    StatBlock m_statBlocks[StatBlocks];                 // Counters by thread slot
+    Stats m_statsBaseline;                              // Totals when the statistics were last reset
+
+    // Member variables of updateAllBudgeted. An instance owes every budgeted update since the one it was last
+    // advanced in, so updates that are not budgeted (which advance every instance by one) leave the debts alone.
+    static const int PriorityLevels = 4;                // Priority levels, 0 being advanced first
+    static const int BudgetCheckInterval = 256;         // Instances advanced between looks at the clock
+    std::vector<int> m_instancePriorities;              // Priority levels of instances
+    std::vector<int> m_instanceUpdateTicks;             // Budgeted update instances were last advanced in
+    int m_budgetTick = 0;                               // Budgeted updates so far
+    std::vector<int> m_budgetOrder;                     // Active slots grouped by priority level
+    int m_budgetCursors[PriorityLevels] = {};           // Position in its group each level resumes from
+    int m_deferredInstances = 0;                        // Instances the last budgeted update deferred
+
+    // Member variables to split updateAll into jobs
+    std::vector<std::vector<AnimationEvent>> m_chunkEvents; // Events recorded by each chunk, kept to reuse their memory
+    std::size_t m_chunkSize = 1;                        // Instances per chunk of the current updateAll
+    std::function<void(int)> m_chunkJob{[this](int chunk) { advanceChunk(chunk); }}; // Job advancing one chunk
+    static const int ParallelGrainSize = 1024;          // Instances per chunk of updateAll() with ANIMATION_PARALLEL_STL
+
+    // Function to set up the properties of a new animation once its texture is stored. Returns the clip id the
+    // caller publishes in the registry, or -1 if the name already has one or no clip id is left.
+    int initAnimation(const std::string &animation, sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                      sf::Vector2i index, int frequency, sf::Vector2i startingIndex);
+
+    // Function to rebuild the flattened data of an animation after one of its properties changed
+    void refreshClip(const std::string &animation);
+    void refreshClip(const std::string &animation, ClipLayout &clip);
+
+    // Functions to move an animation to the frame at an index, shared by setAnimationIndex and initAnimation
+    void applyAnimationIndex(const std::string &animation, sf::Vector2i index);
+    void applyAnimationIndex(int clipId, sf::Vector2i index);
+
+    // Function to set the elapsed update calls of update() on a clip, from which its current index follows
+    void setElapsed(int clipId, int elapsed);
+
+    // Function to get the flattened data of a clip id
+    ClipLayout &clipLayout(int clipId);
+
+    // Functions shared by update and updateAll to turn elapsed update calls into frames
+    static int advanceTime(const PlaybackParams &params, int time, int calls);
+    static int sampleFrame(const ClipLayout &clip, const PlaybackParams &params, int time);
+    static sf::Vector2i frameIndex(const ClipLayout &clip, int frame);
+    static sf::IntRect frameRect(const ClipLayout &clip, int frame);
+    static int frameStartTime(const ClipLayout &clip, int frame);
+
+    // Function to give a marker name an id, leaving 0 for FinishedMarker
+    int markerId(const std::string &marker);
+
+    // Functions to convert between handles and instances; instanceFromHandle returns -1 for a handle whose
+    // instance was destroyed or released, even if another instance has been given its index since
+    int instanceFromHandle(int handle) const;
+    int instanceHandle(int instance) const;
+
+    // Functions to destroy or restart an instance found from its handle, and to free an instance's index under
+    // a new generation so its old handles stop matching
+    void destroyInstanceAt(int instance);
+    void restartInstanceAt(int instance);
+    void recycleInstance(int instance);
+
+    // Functions to set up a new instance and to switch an instance to a state of its state machine
+    int allocateInstance();
+    void resetInstance(int instance);
+    void resizeInstances(int count);
+    void spawnInstance(int instance, int clip, int mode);
+    void enterState(int instance, int state);
+    void beginCrossfade(int instance, int duration);
+
+    // Functions to gather quads into batches for drawAll
+    std::vector<sf::Vertex> &batchVertices(const sf::Texture *texture);
+    RenderBatch &findBatch(const sf::Texture *texture);
+    void takeFrame();
+
+    // Function run by the worker of drawAllPipelined, generating the segments of each frame in order
+    void generateSegments();
+    static void appendQuad(std::vector<sf::Vertex> &vertices, sf::Vector2f position, sf::Vector2f scale,
+                           const sf::IntRect &rect, std::uint8_t alpha);
+
+    // Functions to run the commands posted by other threads and the spawn shards
+    void executeCommands();
+    void runCommand(const AnimationCommand &command);
+
+    // Functions making up updateAll: the kernel for one active slot (returning whether its frame changed), the
+    // kernel over a range of the active set, the same kernel over one chunk of a parallel update, and the serial
+    // rest (state machines, finished instances, publishing)
+    bool advanceSlot(std::size_t slot, int calls, std::vector<AnimationEvent> &events);
+    void advanceInstances(std::size_t begin, std::size_t end, std::vector<AnimationEvent> &events);
+    void advanceChunk(int chunk);
+    void finishUpdate(std::size_t firstEvent);
+
+    // Function to check whether an instance reached a marker in the update whose state machines are evaluated
+    bool reachedMarker(int instance, int marker) const;
+
+    // Function run by updateAllBudgeted, and by updateAll while instances are deferred, with the time to stop at
+    int advanceByPriority(std::chrono::steady_clock::time_point deadline);
+
+    // Functions to split the active set into chunks and to join the events the chunks recorded
+    int prepareChunks(int grainSize);
+    void joinChunkEvents(int chunks);
+
+    // Functions to add up the memory of one animation's map entries and clip, and the bytes of one instance
+    void addAnimationMemory(const std::string &animation, MemoryUsage &usage);
+    std::size_t instanceBytes() const;
+
+    // Function to add to a counter of the calling thread's block (does nothing built with ANIMATION_NO_STATS)
+    void addStat(StatCounter counter, long long amount);
+
+    // Function to count a draw call of a frame, given the texture of the call before (nullptr for the first)
+    // and whether it continues the same batch
+    static void countDrawCall(DrawStats &frame, const sf::Texture *texture, const sf::Texture *previous,
+                              bool sameBatch, std::size_t vertices);
+
+    // Function to keep the draw calls of a frame and add them to the statistics
+    void recordDrawStats(const DrawStats &frame);
+
+    // Function to write the frame records of all visible instances and publish them to drawAll
+    void publishFrame();
+
+    // Functions to move instances in and out of the active set
+    void activateInstance(int instance);
+    void deactivateInstance(int instance);
+
+    // Functions to move instances in and out of the live set walked by publishFrame
+    void addLiveInstance(int instance);
+    void removeLiveInstance(int instance);
+
+public:
+    // Constructor and destructor; a context owns its animations and cannot be copied
+    AnimationContext();
+    AnimationContext(const AnimationContext &) = delete;
+    AnimationContext &operator=(const AnimationContext &) = delete;
+    ~AnimationContext();
+
+    // Function to update the animation frame for a specific sprite. It never allocates or locks, and takes the
+    // name as a view so a string literal is looked up as it is.
+    void update(std::string_view animation, sf::Sprite &sprite);
+
+    // Function to update all animations in a given map of sprites
+    void updateAll(std::map<std::string, sf::Sprite> &map);
+
+    // Function to advance every active instance by one update call. Built with ANIMATION_PARALLEL_STL defined,
+    // it runs chunks of instances through the standard parallel algorithms, with the same results.
+    void updateAll();
+
+    // Function to advance every active instance like updateAll(), running chunks of grainSize instances as jobs.
+    // The results and the order of the events are the same as with updateAll().
+    void updateAll(AnimationJobSystem &jobs, int grainSize = 256);
+
+    // Function to advance active instances like updateAll(), in order of priority level, until the budget is used
+    // up. The clock is checked every 256 instances, so at least that many are advanced. The instances left over
+    // are deferred: each level resumes where it stopped at the next budgeted update, and a deferred instance is
+    // advanced by every update it missed, landing on the frame it would have shown and recording the markers of the
+    // frames passed on the way. The next plain updateAll catches every deferred instance up. Returns the number
+    // deferred.
+    int updateAllBudgeted(double budgetMilliseconds);
+
+    // Function to set the priority level of an instance for updateAllBudgeted, from 0 (advanced first, the default)
+    // to 3, for example by distance to the camera
+    void setInstancePriority(int instance, int priority);
+
+    // Function to get the number of instances the last budgeted update deferred
+    int getDeferredCount() const;
+
+    // Functions to add a new animation with the specified parameters. Unlike the other functions changing animations,
+    // they may be called from a streaming thread while updateAll, drawAll, createInstance and getAnimationId run
+    // on the updating thread, as long as the animation's name is new.
+    void addAnimation(const std::string &animation, const sf::Texture &texture,
+                      sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                      sf::Vector2i index = {0, 0}, int frequency = 0,
+                      sf::Vector2i startingIndex = {0, 0});
+
+    // The same, sharing the texture of an existing animation so both are drawn in one batch
+    void addAnimation(const std::string &animation, const std::string &textureAnimation,
+                      sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                      sf::Vector2i index = {0, 0}, int frequency = 0,
+                      sf::Vector2i startingIndex = {0, 0});
+
+    // Function to add a chunk of animations at once, publishing their names to lookups together, so streaming
+    // in a level copies the name registry once per chunk instead of once per animation
+    void addAnimations(const std::vector<AnimationDefinition> &animations);
+
+    // Function to delete an existing animation (and any instances playing it). Animations used by a state
+    // machine are kept, as its compiled states refer to them by clip id.
+    void deleteAnimation(const std::string &animation);
+
+    // Setter functions to modify animation properties
+    void setAnimationFrequency(const std::string &animation, int frequency);
+    void setAnimationSpriteSize(const std::string &animation, sf::Vector2i size);
+    void setAnimationSheetSize(const std::string &animation, sf::Vector2i size);
+    void setAnimationIndex(const std::string &animation, sf::Vector2i index);
+    void setAnimationTexture(const std::string &animation, const sf::Texture &texture);
+    void setAnimationStartingIndex(const std::string &animation, sf::Vector2i index);
+    void setAnimationEndingIndex(const std::string &animation, sf::Vector2i index);
+    void setAnimationPlaybackMode(const std::string &animation, PlaybackMode mode);
+
+    // Function to give each frame its own duration in update calls (an empty list restores the frequency)
+    void setAnimationFrameDurations(const std::string &animation, const std::vector<int> &durations);
+
+    // Function to mark a frame (counted from the starting index) and return the marker's id
+    int addAnimationMarker(const std::string &animation, int frame, const std::string &marker);
+
+    // Function to remove every marker of an animation
+    void clearAnimationMarkers(const std::string &animation);
+
+    // Function to look up the id of a marker name (returns -1 if it was never added)
+    int getMarkerId(const std::string &marker);
+
+    // Function to jump an animation to the frame shown after the given number of update calls
+    void seekAnimation(const std::string &animation, int elapsed);
+
+    // Function to reset the animation index to the starting index
+    void resetAnimationIndex(const std::string &animation);
+
+    // Functions to create and destroy independent instances of an animation (returns -1 if not found). Every
+    // function taking a handle ignores one whose instance was destroyed or released.
+    int createInstance(const std::string &animation);
+    int createInstance(const std::string &animation, PlaybackMode mode);
+    void destroyInstance(int instance);
+
+    // Function to play an instance again from its first frame
+    void restartInstance(int instance);
+
+    // Function to hold an instance on its current frame until it is restarted
+    void stopInstance(int instance);
+
+    // Function to jump an instance to the frame shown after the given number of update calls
+    void seekInstance(int instance, int elapsed);
+
+    // Function to set how many update calls an instance advances per updateAll (1 by default)
+    void setInstanceSpeed(int instance, float speed);
+
+    // Function to check whether an instance is still being advanced by updateAll
+    bool isInstanceActive(int instance);
+
+    // Function to look up the clip id of an animation, for queueSpawn (returns -1 if not found)
+    int getAnimationId(const std::string &animation);
+
+    // Functions any thread can call to control instances. The commands run at the start of the next
+    // updateAll, in the order each thread posted them, and return false (or -1) if the queue is full.
+    // A command for an instance destroyed or released before it runs is dropped, even if its index was reused.
+    bool queuePlay(int instance);
+    bool queueStop(int instance);
+    bool queueSeek(int instance, int elapsed);
+    bool queueSetSpeed(int instance, float speed);
+    int queueSpawn(int animationId, PlaybackMode mode = PlaybackMode::Loop);
+    bool queueDestroy(int instance);
+
+    // Function to create a shard through which one worker thread spawns and destroys instances without
+    // contending with other threads, merged at the start of each updateAll. Call it from the updating thread.
+    AnimationSpawnShard &createSpawnShard(std::size_t capacity = 4096);
+
+    // Function to switch an instance to another animation, fading out of its current frame over the given update calls
+    void crossfadeInstance(int instance, const std::string &animation, int duration);
+
+    // Functions to place instances for drawAll
+    void setInstancePosition(int instance, sf::Vector2f position);
+    void setInstanceScale(int instance, sf::Vector2f scale);
+    void setInstanceVisible(int instance, bool visible);
+
+    // Function to draw every visible instance with one draw call per texture, as of the last updateAll.
+    // It only reads the published frame, so it may run on another thread concurrently with updateAll.
+    void drawAll(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default);
+
+    // Function to draw like drawAll, with a worker generating the vertices of the next segment of up to
+    // 2048 quads while the current one is drawn. Segments of one texture are drawn with one call each.
+    void drawAllPipelined(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default);
+
+    // Functions to get and reset the times accumulated by drawAllPipelined
+    DrawTimings getDrawTimings() const;
+    void resetDrawTimings();
+
+    // Functions to get the counters summed over all threads since the last reset, and to reset them. Call
+    // them from the updating thread; counts from an updateAll still running on workers may be partly included.
+    Stats getStats() const;
+    void resetStats();
+
+    // Function to get the draw calls, texture switches, vertices and batch breaks of the latest drawAll or
+    // drawAllPipelined. Call it from the drawing thread.
+    DrawStats getFrameDrawStats() const;
+
+    // Functions to get the memory used by the whole context, or by one animation and the instances playing it.
+    // An animation's texture is counted in full even if it is shared; the context counts each texture once.
+    MemoryUsage getMemoryUsage();
+    MemoryUsage getMemoryUsage(const std::string &animation);
+
+    // Function to count the instances of every animation and how many of them are active, in name order.
+    // It walks all instances, so call it for debugging views rather than every frame of a shipped game.
+    void getClipInstances(std::vector<ClipInstances> &clips);
+
+    // Function to compile a state machine into transition tables (returns its id, or -1 on error)
+    int addStateMachine(const AnimationStateMachine &stateMachine);
+
+    // Function to create an instance that starts in the initial state of a state machine
+    int createStateMachineInstance(int stateMachine);
+
+    // Function to set a state machine parameter of an instance
+    void setInstanceParameter(int instance, int parameter, float value);
+
+    // Function to get the state an instance is in (returns -1 if it has no state machine)
+    int getInstanceState(int instance);
+
+    // Function to copy the current frame of an instance onto a sprite
+    void applyInstance(int instance, sf::Sprite &sprite);
+
+    // Function to hand the events recorded by updateAll to the caller, leaving the internal buffer empty
+    void drainEvents(std::vector<AnimationEvent> &events);
+};
@@ -0,0 +1,209 @@
+#include "AnimationDebugOverlay.h"
+#include <algorithm>
+#include <cstdio>
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationDebugOverlay class. The text is laid out like sf::Text, from the glyphs of the font's
+// texture for the character size, and the background is a quad sampling the white square SFML keeps
+// at the top-left corner of every font texture, so glyphs and background share a texture and a draw call.
+// Tabs in a line move to the next column, eight character sizes apart, to line up the tables.
+
+namespace {
+    // Colours and spacing of the panel
+    const sf::Color BackgroundColor(0, 0, 0, 176);
+    const sf::Color TitleColor(255, 220, 96);
+    const sf::Color TextColor(232, 232, 232);
+    const sf::Color QuietColor(150, 150, 150);
+    const float Padding = 6.f;
+    const int TabCharacters = 8;
+}
+
+AnimationDebugOverlay::AnimationDebugOverlay(AnimationContext &context, const sf::Font &font, unsigned characterSize)
+    : m_context(context), m_font(font), m_characterSize(characterSize) {
+    // Start averaging from the counters as they are now
+    m_lastStats = m_context.getStats();
+    for (int phase = 0; phase < static_cast<int>(AnimationProfiler::Phase::Count); ++phase) {
+        m_lastPhases[phase] = AnimationProfiler::getHistogram(static_cast<AnimationProfiler::Phase>(phase));
+    }
+}
+
+void AnimationDebugOverlay::setPosition(sf::Vector2f position) {
+    m_position = position;
+}
+
+void AnimationDebugOverlay::setMaxClips(int maxClips) {
+    m_maxClips = std::max(0, maxClips);
+}
+
+void AnimationDebugOverlay::refresh() {
+    char text[160];
+    std::size_t lineCount = 0;
+    auto addLine = [&](sf::Color color) {
+        if (m_lines.size() <= lineCount) {
+            m_lines.emplace_back();
+            m_lineColors.emplace_back();
+        }
+        m_lines[lineCount].assign(text);
+        m_lineColors[lineCount] = color;
+        ++lineCount;
+    };
+
+    // Count the instances of every animation, those with the most instances first
+    m_context.getClipInstances(m_clips);
+    std::stable_sort(m_clips.begin(), m_clips.end(),
+                     [](const AnimationContext::ClipInstances &a, const AnimationContext::ClipInstances &b) {
+                         return a.instances > b.instances;
+                     });
+    long long instances = 0;
+    long long active = 0;
+    for (const AnimationContext::ClipInstances &clip: m_clips) {
+        instances += clip.instances;
+        active += clip.active;
+    }
+
+    // Take the updates and events since the last refresh, starting over if the statistics were reset
+    const AnimationContext::Stats stats = m_context.getStats();
+    if (stats.updates < m_lastStats.updates) {
+        m_lastStats = AnimationContext::Stats();
+    }
+    const long long updates = stats.updates - m_lastStats.updates;
+    const long long events = stats.eventsEmitted - m_lastStats.eventsEmitted;
+    m_lastStats = stats;
+    const AnimationContext::DrawStats drawStats = m_context.getFrameDrawStats();
+    const AnimationContext::MemoryUsage usage = m_context.getMemoryUsage();
+
+    // Write the totals
+    std::snprintf(text, sizeof(text), "Animations");
+    addLine(TitleColor);
+    std::snprintf(text, sizeof(text), "instances %lld\tactive %lld\tasleep %lld", instances, active,
+                  instances - active);
+    addLine(TextColor);
+    std::snprintf(text, sizeof(text), "events/update %.1f\tdraw calls %d\tvertices %lld",
+                  updates > 0 ? static_cast<double>(events) / static_cast<double>(updates) : 0.0,
+                  drawStats.drawCalls, drawStats.verticesSubmitted);
+    addLine(TextColor);
+    std::snprintf(text, sizeof(text), "texture memory %.1f MiB",
+                  static_cast<double>(usage.texturePixels) / (1024.0 * 1024.0));
+    addLine(TextColor);
+
+    // Write the mean time of every phase timed since the last refresh
+    std::snprintf(text, sizeof(text), "Phases\tms");
+    addLine(TitleColor);
+    bool timed = false;
+    for (int phase = 0; phase < static_cast<int>(AnimationProfiler::Phase::Count); ++phase) {
+        const AnimationProfiler::Histogram histogram =
+                AnimationProfiler::getHistogram(static_cast<AnimationProfiler::Phase>(phase));
+        AnimationProfiler::Histogram &last = m_lastPhases[phase];
+        if (histogram.samples < last.samples) {
+            last = AnimationProfiler::Histogram();
+        }
+        const std::uint64_t samples = histogram.samples - last.samples;
+        if (samples > 0) {
+            std::snprintf(text, sizeof(text), "%s\t%.3f",
+                          AnimationProfiler::getPhaseName(static_cast<AnimationProfiler::Phase>(phase)),
+                          static_cast<double>(histogram.totalNanoseconds - last.totalNanoseconds) /
+                          static_cast<double>(samples) / 1e6);
+            addLine(TextColor);
+            timed = true;
+        }
+        last = histogram;
+    }
+    if (!timed) {
+        std::snprintf(text, sizeof(text), "build with ANIMATION_PROFILING");
+        addLine(QuietColor);
+    }
+
+    // Write the animations with the most instances
+    std::snprintf(text, sizeof(text), "Animation\tinstances\tactive");
+    addLine(TitleColor);
+    const int listed = std::min(m_maxClips, static_cast<int>(m_clips.size()));
+    for (int clip = 0; clip < listed; ++clip) {
+        std::snprintf(text, sizeof(text), "%.24s\t%d\t%d", m_clips[clip].animation.c_str(), m_clips[clip].instances,
+                      m_clips[clip].active);
+        addLine(TextColor);
+    }
+    if (listed < static_cast<int>(m_clips.size())) {
+        std::snprintf(text, sizeof(text), "%d more", static_cast<int>(m_clips.size()) - listed);
+        addLine(QuietColor);
+    }
+
+    // Build the background behind the widest line, then the glyphs of every line
+    const float lineSpacing = m_font.getLineSpacing(m_characterSize);
+    float width = 0.f;
+    for (std::size_t line = 0; line < lineCount; ++line) {
+        width = std::max(width, lineWidth(m_lines[line]));
+    }
+    m_vertices.clear();
+    appendRectangle(sf::FloatRect(m_position, {width + 2.f * Padding, lineSpacing * lineCount + 2.f * Padding}),
+                    BackgroundColor);
+    for (std::size_t line = 0; line < lineCount; ++line) {
+        appendLine(m_lines[line], {m_position.x + Padding, m_position.y + Padding + lineSpacing * line},
+                   m_lineColors[line]);
+    }
+}
+
+void AnimationDebugOverlay::draw(sf::RenderTarget &target, sf::RenderStates states) const {
+    // Draw the background and every glyph with one call
+    if (!m_vertices.empty()) {
+        states.texture = &m_font.getTexture(m_characterSize);
+        target.draw(m_vertices.data(), m_vertices.size(), sf::PrimitiveType::Triangles, states);
+    }
+}
+
+void AnimationDebugOverlay::appendRectangle(sf::FloatRect rect, sf::Color color) {
+    // Sample the middle of the font texture's white square, so the quad takes the vertex colour
+    const sf::Vector2f white(1.f, 1.f);
+    const sf::Vector2f topLeft = rect.position;
+    const sf::Vector2f bottomRight = rect.position + rect.size;
+    const sf::Vector2f topRight(bottomRight.x, topLeft.y);
+    const sf::Vector2f bottomLeft(topLeft.x, bottomRight.y);
+    m_vertices.push_back({topLeft, color, white});
+    m_vertices.push_back({topRight, color, white});
+    m_vertices.push_back({bottomLeft, color, white});
+    m_vertices.push_back({bottomLeft, color, white});
+    m_vertices.push_back({topRight, color, white});
+    m_vertices.push_back({bottomRight, color, white});
+}
+
+void AnimationDebugOverlay::appendLine(const std::string &text, sf::Vector2f position, sf::Color color) {
+    const float tabWidth = static_cast<float>(m_characterSize * TabCharacters);
+    const float baseline = position.y + static_cast<float>(m_characterSize);
+    float x = 0.f;
+    for (char character: text) {
+        if (character == '\t') {
+            // Move to the next column
+            x = (static_cast<int>(x / tabWidth) + 1) * tabWidth;
+            continue;
+        }
+
+        // Add the glyph's quad, with its texture rectangle, unless it has no pixels like a space
+        const sf::Glyph &glyph = m_font.getGlyph(static_cast<unsigned char>(character), m_characterSize, false);
+        if (glyph.bounds.size.x > 0.f && glyph.bounds.size.y > 0.f) {
+            const sf::Vector2f topLeft(position.x + x + glyph.bounds.position.x, baseline + glyph.bounds.position.y);
+            const sf::Vector2f bottomRight = topLeft + glyph.bounds.size;
+            const sf::Vector2f textureTopLeft(glyph.textureRect.position);
+            const sf::Vector2f textureBottomRight(glyph.textureRect.position + glyph.textureRect.size);
+            m_vertices.push_back({topLeft, color, textureTopLeft});
+            m_vertices.push_back({{bottomRight.x, topLeft.y}, color, {textureBottomRight.x, textureTopLeft.y}});
+            m_vertices.push_back({{topLeft.x, bottomRight.y}, color, {textureTopLeft.x, textureBottomRight.y}});
+            m_vertices.push_back({{topLeft.x, bottomRight.y}, color, {textureTopLeft.x, textureBottomRight.y}});
+            m_vertices.push_back({{bottomRight.x, topLeft.y}, color, {textureBottomRight.x, textureTopLeft.y}});
+            m_vertices.push_back({bottomRight, color, textureBottomRight});
+        }
+        x += glyph.advance;
+    }
+}
+
+float AnimationDebugOverlay::lineWidth(const std::string &text) const {
+    // Measure the line the way appendLine lays it out
+    const float tabWidth = static_cast<float>(m_characterSize * TabCharacters);
+    float x = 0.f;
+    for (char character: text) {
+        if (character == '\t') {
+            x = (static_cast<int>(x / tabWidth) + 1) * tabWidth;
+        } else {
+            x += m_font.getGlyph(static_cast<unsigned char>(character), m_characterSize, false).advance;
+        }
+    }
+    return x;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "AnimationContext.h"
+#include "AnimationProfiler.h"
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+
+// This header file defines the AnimationDebugOverlay class, a drawable panel that shows what the animations
+// of a context cost while the game runs. The class provides functions to:
+// - Show how many instances each animation has and how many of them are active or asleep.
+// - Show the time of each updateAll phase, when the library is built with ANIMATION_PROFILING.
+// - Show the events recorded per update, the draw calls of the last frame and the texture memory.
+// - Draw the whole panel, background included, with a single draw call from the font's texture.
+// The overlay reads the context only in refresh, so drawing it costs one draw call and no lookups.
+
+class AnimationDebugOverlay : public sf::Drawable {
+public:
+    // Function to create an overlay for a context, written with a font at a character size. The font
+    // and the context must outlive the overlay.
+    AnimationDebugOverlay(AnimationContext &context, const sf::Font &font, unsigned characterSize = 12);
+
+    // Function to set where the panel's top-left corner is drawn
+    void setPosition(sf::Vector2f position);
+
+    // Function to set how many animations are listed, those with the most instances first (8 by default)
+    void setMaxClips(int maxClips);
+
+    // Function to read the context and rebuild the panel. Call it from the updating thread, after updateAll,
+    // every frame or every few frames; times and events are averaged over the updates since the last call.
+    void refresh();
+
+private:
+    // Function to draw the panel with one call
+    void draw(sf::RenderTarget &target, sf::RenderStates states) const override;
+
+    // Functions to build the vertices of the panel
+    void appendRectangle(sf::FloatRect rect, sf::Color color);
+    void appendLine(const std::string &text, sf::Vector2f position, sf::Color color);
+    float lineWidth(const std::string &text) const;
+
+    // Member variables of the overlay
+    AnimationContext &m_context;                 // Context shown
+    const sf::Font &m_font;                      // Font of the text
+    unsigned m_characterSize;                    // Character size of the text
+    sf::Vector2f m_position{8.f, 8.f};           // Top-left corner of the panel
+    int m_maxClips = 8;                          // Most animations listed
+
+    // Member variables to average over the updates between refreshes
+    AnimationContext::Stats m_lastStats;         // Counters at the last refresh
+    AnimationProfiler::Histogram m_lastPhases[static_cast<int>(AnimationProfiler::Phase::Count)]; // Histograms then
+
+    // Member variables reused by every refresh, to keep their memory
+    std::vector<AnimationContext::ClipInstances> m_clips; // Instances by animation
+    std::vector<std::string> m_lines;            // Text of the panel, one string per line
+    std::vector<sf::Color> m_lineColors;         // Colours of the lines
+    std::vector<sf::Vertex> m_vertices;          // Two triangles per glyph, after those of the background
+};
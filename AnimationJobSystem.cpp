@@ -0,0 +1,144 @@
+#include "AnimationJobSystem.h"
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationWorkStealingPool class. parallelFor splits the indices evenly between the
+// workers, wakes the pool's threads and works through the first share on the calling thread.
+// Each worker takes indices from the front of its own range; an idle worker locks another
+// worker's range and moves its upper half over. The calling thread returns once the count of
+// unfinished indices reaches zero, and since a worker only reads the job after taking an index,
+// no thread can still use the job once parallelFor has returned.
+
+AnimationWorkStealingPool::AnimationWorkStealingPool(int workerCount) {
+    // Use one worker per core unless told otherwise
+    if (workerCount <= 0) {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    m_workerCount = workerCount > 0 ? workerCount : 1;
+    m_ranges.reset(new WorkerRange[m_workerCount]);
+
+    // Start the workers besides the calling thread
+    for (int worker = 1; worker < m_workerCount; ++worker) {
+        m_threads.emplace_back(&AnimationWorkStealingPool::workerLoop, this, worker);
+    }
+}
+
+AnimationWorkStealingPool::~AnimationWorkStealingPool() {
+    // Wake the workers one last time so they leave their loops
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &thread: m_threads) {
+        thread.join();
+    }
+}
+
+void AnimationWorkStealingPool::parallelFor(int count, const std::function<void(int)> &job) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Publish the job before any index, so a worker that takes an index also sees the job
+    m_job.store(&job, std::memory_order_relaxed);
+    m_remaining.store(count, std::memory_order_relaxed);
+
+    // Give each worker an equal share of the indices
+    for (int worker = 0; worker < m_workerCount; ++worker) {
+        std::lock_guard<std::mutex> lock(m_ranges[worker].mutex);
+        m_ranges[worker].begin = static_cast<int>(static_cast<long long>(count) * worker / m_workerCount);
+        m_ranges[worker].end = static_cast<int>(static_cast<long long>(count) * (worker + 1) / m_workerCount);
+    }
+
+    // Wake the other workers and take part as the first one
+    if (!m_threads.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_generation;
+        }
+        m_wake.notify_all();
+    }
+    runWorker(0);
+
+    // Wait for indices other workers are still running
+    while (m_remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+int AnimationWorkStealingPool::getWorkerCount() const {
+    return m_workerCount;
+}
+
+std::uint64_t AnimationWorkStealingPool::getStealCount() const {
+    return m_steals.load(std::memory_order_relaxed);
+}
+
+void AnimationWorkStealingPool::workerLoop(int worker) {
+    std::uint64_t generation = 0;
+    for (;;) {
+        // Sleep until the next parallelFor or until the pool is destroyed
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != generation; });
+            if (m_stopping) {
+                return;
+            }
+            generation = m_generation;
+        }
+        runWorker(worker);
+    }
+}
+
+void AnimationWorkStealingPool::runWorker(int worker) {
+    // Run the worker's own indices, then stolen ones, until every range is empty
+    int index;
+    for (;;) {
+        if (!takeIndex(worker, index)) {
+            if (!stealRange(worker)) {
+                return;
+            }
+            continue;
+        }
+        (*m_job.load(std::memory_order_relaxed))(index);
+        m_remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool AnimationWorkStealingPool::takeIndex(int worker, int &index) {
+    // Take the next index from the front of the worker's range
+    WorkerRange &range = m_ranges[worker];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    if (range.begin >= range.end) {
+        return false;
+    }
+    index = range.begin++;
+    return true;
+}
+
+bool AnimationWorkStealingPool::stealRange(int worker) {
+    // Look for a worker with indices left, starting after this one so thieves spread out
+    WorkerRange &range = m_ranges[worker];
+    for (int offset = 1; offset < m_workerCount; ++offset) {
+        WorkerRange &victim = m_ranges[(worker + offset) % m_workerCount];
+
+        // Lock both ranges, so indices a new parallelFor gave this worker meanwhile are never overwritten
+        std::unique_lock<std::mutex> rangeLock(range.mutex, std::defer_lock);
+        std::unique_lock<std::mutex> victimLock(victim.mutex, std::defer_lock);
+        std::lock(rangeLock, victimLock);
+        if (range.begin < range.end) {
+            return true;
+        }
+        if (victim.begin >= victim.end) {
+            continue;
+        }
+
+        // Move the upper half over, or the last index if only one is left
+        range.end = victim.end;
+        range.begin = victim.begin + (victim.end - victim.begin) / 2;
+        victim.end = range.begin;
+        m_steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
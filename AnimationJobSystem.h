@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// This header file defines the AnimationJobSystem interface, through which AnimationContext::updateAll
+// hands chunks of instances to worker threads, and AnimationWorkStealingPool, the bundled
+// implementation. The classes provide functions to:
+// - Run a job for every index of a range on several threads and return once all have finished.
+// - Plug in an engine's own job system by deriving from AnimationJobSystem.
+// The pool gives each worker an equal share of the indices up front. A worker that runs out of
+// indices steals the upper half of the largest remaining share, so chunks that turn out heavier
+// than others (event-rich clips, for example) no longer hold up the whole update.
+
+class AnimationJobSystem {
+public:
+    virtual ~AnimationJobSystem() = default;
+
+    // Function to call job(index) for every index in [0, count) and return once every call has returned.
+    // The calls may run concurrently on any thread, including the calling one, and in any order.
+    virtual void parallelFor(int count, const std::function<void(int)> &job) = 0;
+};
+
+class AnimationWorkStealingPool : public AnimationJobSystem {
+public:
+    // Constructor taking the number of workers, including the thread calling parallelFor (0 uses one per core)
+    explicit AnimationWorkStealingPool(int workerCount = 0);
+    ~AnimationWorkStealingPool() override;
+
+    AnimationWorkStealingPool(const AnimationWorkStealingPool &) = delete;
+    AnimationWorkStealingPool &operator=(const AnimationWorkStealingPool &) = delete;
+
+    // Function to run the job over [0, count), with the calling thread working as the first worker
+    void parallelFor(int count, const std::function<void(int)> &job) override;
+
+    // Function to get the number of workers, including the calling thread
+    int getWorkerCount() const;
+
+    // Function to get how many ranges have been stolen since the pool was created
+    std::uint64_t getStealCount() const;
+
+private:
+    // Indices a worker still has to run, on its own cache line so workers do not slow each other down
+    struct alignas(64) WorkerRange {
+        std::mutex mutex; // Guards begin and end against thieves
+        int begin = 0;    // Next index the worker runs
+        int end = 0;      // One past the last index of the worker
+    };
+
+    // Function run by the pool's threads, waking once per parallelFor
+    void workerLoop(int worker);
+
+    // Function to run indices until no worker has any left
+    void runWorker(int worker);
+
+    // Functions to take the next index of a worker and to refill a worker from the others
+    bool takeIndex(int worker, int &index);
+    bool stealRange(int worker);
+
+    std::unique_ptr<WorkerRange[]> m_ranges;                 // Remaining indices of each worker
+    std::vector<std::thread> m_threads;                      // Workers besides the calling thread
+    int m_workerCount;                                       // Number of workers, including the calling thread
+    std::atomic<const std::function<void(int)> *> m_job{nullptr}; // Job of the current parallelFor
+    alignas(64) std::atomic<int> m_remaining{0};             // Indices not finished yet
+    alignas(64) std::atomic<std::uint64_t> m_steals{0};      // Ranges stolen so far
+    std::mutex m_mutex;                                      // Guards m_generation and m_stopping
+    std::condition_variable m_wake;                          // Wakes the threads for a new parallelFor
+    std::uint64_t m_generation = 0;                          // Number of parallelFor calls so far
+    bool m_stopping = false;                                 // Set when the pool is destroyed
+};
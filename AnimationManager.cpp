@@ -1,130 +1,259 @@
 #include "AnimationManager.h"
-#include <iostream>
-
-// This implementation file provides the definitions for the member functions declared
-// in the AnimationManager class. The key functionalities implemented include:
-// - update: Updates the animation frame for a specific sprite based on the animation's frequency.
-// - updateAll: Updates all animations in a given map of sprites.
-// - addAnimation: Adds a new animation with specified parameters (texture, sheet size, sprite size, etc.).
-// - deleteAnimation: Deletes an existing animation.
-// - Setters: Modify animation properties such as frequency, sprite size, sheet size, and indices.
-// The file initializes the static member variables and provides the logic for updating and managing
-// animations in a game. Error handling and frequency-based updates are also implemented to ensure
-// smooth animation transitions.
-
-// Initialize static member variables
-std::map<std::string, sf::Texture> AnimationManager::m_textures;
-std::map<std::string, sf::Vector2i> AnimationManager::m_indices;
-std::map<std::string, sf::Vector2i> AnimationManager::m_startingIndices;
-std::map<std::string, sf::Vector2i> AnimationManager::m_endingIndices;
-std::map<std::string, sf::Vector2i> AnimationManager::m_sheetSizes;
-std::map<std::string, sf::Vector2i> AnimationManager::m_spriteSizes;
-std::map<std::string, int> AnimationManager::m_frequencies;
-std::map<std::string, int> AnimationManager::m_timesUpdated;
-
-void AnimationManager::update(const std::string &animation, sf::Sprite &sprite) {
-    // Check if the animation sheet size is valid
-    if (m_sheetSizes[animation] != sf::Vector2i(0, 0)) {
-        // Increment the update counter and check if it meets the frequency condition
-        if (++m_timesUpdated[animation] >= m_frequencies[animation]) {
-            m_timesUpdated[animation] = 0; // Reset the update counter
-
-            // Calculate the texture rectangle for the current frame
-            sf::IntRect rect({
-                                 m_indices[animation].x * m_spriteSizes[animation].x,
-                                 m_indices[animation].y * m_spriteSizes[animation].y
-                             },
-                             {m_spriteSizes[animation].x, m_spriteSizes[animation].y});
-
-            // Set the sprite texture and texture rectangle
-            sprite.setTexture(m_textures[animation]);
-            sprite.setTextureRect(rect);
-
-            // Update the animation indices to the next frame
-            if (m_indices[animation].y < m_sheetSizes[animation].y - 1) {
-                ++m_indices[animation].y;
-            } else if (m_indices[animation].x < m_sheetSizes[animation].x - 1) {
-                m_indices[animation].y = 0;
-                ++m_indices[animation].x;
-            } else {
-                m_indices[animation] = m_startingIndices[animation]; // Reset to starting index for looping animation
-            }
-        }
-    } else {
-        // Output an error message if no animation entry is found
-        std::cerr << "No animation entry found for \"" << animation << "\"!" << std::endl;
-    }
+
+// This implementation file provides the definitions for the static member functions declared
+// in the AnimationManager class. Each one forwards to the default context.
+
+AnimationContext &AnimationManager::defaultContext() {
+    // Create the default context on first use
+    static AnimationContext context;
+    return context;
+}
+
+void AnimationManager::update(std::string_view animation, sf::Sprite &sprite) {
+    defaultContext().update(animation, sprite);
 }
 
 void AnimationManager::updateAll(std::map<std::string, sf::Sprite> &map) {
-    // Iterate through the map and update each animation
-    for (auto &element: map) {
-        update(element.first, element.second);
-    }
+    defaultContext().updateAll(map);
+}
+
+void AnimationManager::updateAll() {
+    defaultContext().updateAll();
+}
+
+void AnimationManager::updateAll(AnimationJobSystem &jobs, int grainSize) {
+    defaultContext().updateAll(jobs, grainSize);
+}
+
+int AnimationManager::updateAllBudgeted(double budgetMilliseconds) {
+    return defaultContext().updateAllBudgeted(budgetMilliseconds);
+}
+
+void AnimationManager::setInstancePriority(int instance, int priority) {
+    defaultContext().setInstancePriority(instance, priority);
+}
+
+int AnimationManager::getDeferredCount() {
+    return defaultContext().getDeferredCount();
 }
 
 void AnimationManager::addAnimation(const std::string &animation, const sf::Texture &texture,
-                                    sf::Vector2i sheetSize, sf::Vector2i spriteSize,
-                                    sf::Vector2i index, int frequency,
-                                    sf::Vector2i startingIndex) {
-    // Add a new animation with the specified parameters
-    m_textures[animation] = texture;
-    m_sheetSizes[animation] = sheetSize;
-    m_spriteSizes[animation] = spriteSize;
-    m_indices[animation] = index;
-    m_startingIndices[animation] = startingIndex;
-    m_endingIndices[animation] = sheetSize;
-    m_frequencies[animation] = frequency;
-    m_timesUpdated[animation] = 0; // Initialize the times updated counter
+                                    sf::Vector2i sheetSize, sf::Vector2i spriteSize, sf::Vector2i index,
+                                    int frequency, sf::Vector2i startingIndex) {
+    defaultContext().addAnimation(animation, texture, sheetSize, spriteSize, index, frequency, startingIndex);
+}
+
+void AnimationManager::addAnimation(const std::string &animation, const std::string &textureAnimation,
+                                    sf::Vector2i sheetSize, sf::Vector2i spriteSize, sf::Vector2i index,
+                                    int frequency, sf::Vector2i startingIndex) {
+    defaultContext().addAnimation(animation, textureAnimation, sheetSize, spriteSize, index, frequency, startingIndex);
+}
+
+void AnimationManager::addAnimations(const std::vector<AnimationDefinition> &animations) {
+    defaultContext().addAnimations(animations);
 }
 
 void AnimationManager::deleteAnimation(const std::string &animation) {
-    // Remove the animation entry from all maps
-    m_textures.erase(animation);
-    m_indices.erase(animation);
-    m_startingIndices.erase(animation);
-    m_endingIndices.erase(animation);
-    m_sheetSizes.erase(animation);
-    m_spriteSizes.erase(animation);
-    m_frequencies.erase(animation);
-    m_timesUpdated.erase(animation);
+    defaultContext().deleteAnimation(animation);
 }
 
 void AnimationManager::setAnimationFrequency(const std::string &animation, int frequency) {
-    // Set the update frequency for the specified animation
-    m_frequencies[animation] = frequency;
+    defaultContext().setAnimationFrequency(animation, frequency);
 }
 
 void AnimationManager::setAnimationSpriteSize(const std::string &animation, sf::Vector2i size) {
-    // Set the sprite size for the specified animation
-    m_spriteSizes[animation] = size;
+    defaultContext().setAnimationSpriteSize(animation, size);
 }
 
 void AnimationManager::setAnimationSheetSize(const std::string &animation, sf::Vector2i size) {
-    // Set the sheet size for the specified animation
-    m_sheetSizes[animation] = size;
+    defaultContext().setAnimationSheetSize(animation, size);
 }
 
 void AnimationManager::setAnimationIndex(const std::string &animation, sf::Vector2i index) {
-    // Set the current index for the specified animation
-    m_indices[animation] = index;
+    defaultContext().setAnimationIndex(animation, index);
 }
 
 void AnimationManager::setAnimationTexture(const std::string &animation, const sf::Texture &texture) {
-    // Set the texture for the specified animation
-    m_textures[animation] = texture;
+    defaultContext().setAnimationTexture(animation, texture);
+}
+
+void AnimationManager::setAnimationStartingIndex(const std::string &animation, sf::Vector2i index) {
+    defaultContext().setAnimationStartingIndex(animation, index);
+}
+
+void AnimationManager::setAnimationEndingIndex(const std::string &animation, sf::Vector2i index) {
+    defaultContext().setAnimationEndingIndex(animation, index);
+}
+
+void AnimationManager::setAnimationPlaybackMode(const std::string &animation, PlaybackMode mode) {
+    defaultContext().setAnimationPlaybackMode(animation, mode);
+}
+
+void AnimationManager::setAnimationFrameDurations(const std::string &animation,
+                                                  const std::vector<int> &durations) {
+    defaultContext().setAnimationFrameDurations(animation, durations);
+}
+
+int AnimationManager::addAnimationMarker(const std::string &animation, int frame, const std::string &marker) {
+    return defaultContext().addAnimationMarker(animation, frame, marker);
+}
+
+void AnimationManager::clearAnimationMarkers(const std::string &animation) {
+    defaultContext().clearAnimationMarkers(animation);
+}
+
+int AnimationManager::getMarkerId(const std::string &marker) {
+    return defaultContext().getMarkerId(marker);
+}
+
+void AnimationManager::seekAnimation(const std::string &animation, int elapsed) {
+    defaultContext().seekAnimation(animation, elapsed);
 }
 
 void AnimationManager::resetAnimationIndex(const std::string &animation) {
-    // Reset the current index to the starting index for the specified animation
-    m_indices[animation] = m_startingIndices[animation];
+    defaultContext().resetAnimationIndex(animation);
 }
 
-void AnimationManager::setAnimationStartingIndex(const std::string &animation, sf::Vector2i index) {
-    // Set the starting index for the specified animation
-    m_startingIndices[animation] = index;
+int AnimationManager::createInstance(const std::string &animation) {
+    return defaultContext().createInstance(animation);
 }
 
-void AnimationManager::setAnimationEndingIndex(const std::string &animation, sf::Vector2i index) {
-    // Set the ending index for the specified animation
-    m_endingIndices[animation] = index
\ No newline at end of file
+int AnimationManager::createInstance(const std::string &animation, PlaybackMode mode) {
+    return defaultContext().createInstance(animation, mode);
+}
+
+void AnimationManager::destroyInstance(int instance) {
+    defaultContext().destroyInstance(instance);
+}
+
+void AnimationManager::restartInstance(int instance) {
+    defaultContext().restartInstance(instance);
+}
+
+void AnimationManager::stopInstance(int instance) {
+    defaultContext().stopInstance(instance);
+}
+
+void AnimationManager::seekInstance(int instance, int elapsed) {
+    defaultContext().seekInstance(instance, elapsed);
+}
+
+void AnimationManager::setInstanceSpeed(int instance, float speed) {
+    defaultContext().setInstanceSpeed(instance, speed);
+}
+
+bool AnimationManager::isInstanceActive(int instance) {
+    return defaultContext().isInstanceActive(instance);
+}
+
+int AnimationManager::getAnimationId(const std::string &animation) {
+    return defaultContext().getAnimationId(animation);
+}
+
+bool AnimationManager::queuePlay(int instance) {
+    return defaultContext().queuePlay(instance);
+}
+
+bool AnimationManager::queueStop(int instance) {
+    return defaultContext().queueStop(instance);
+}
+
+bool AnimationManager::queueSeek(int instance, int elapsed) {
+    return defaultContext().queueSeek(instance, elapsed);
+}
+
+bool AnimationManager::queueSetSpeed(int instance, float speed) {
+    return defaultContext().queueSetSpeed(instance, speed);
+}
+
+int AnimationManager::queueSpawn(int animationId, PlaybackMode mode) {
+    return defaultContext().queueSpawn(animationId, mode);
+}
+
+bool AnimationManager::queueDestroy(int instance) {
+    return defaultContext().queueDestroy(instance);
+}
+
+AnimationSpawnShard &AnimationManager::createSpawnShard(std::size_t capacity) {
+    return defaultContext().createSpawnShard(capacity);
+}
+
+void AnimationManager::crossfadeInstance(int instance, const std::string &animation, int duration) {
+    defaultContext().crossfadeInstance(instance, animation, duration);
+}
+
+void AnimationManager::setInstancePosition(int instance, sf::Vector2f position) {
+    defaultContext().setInstancePosition(instance, position);
+}
+
+void AnimationManager::setInstanceScale(int instance, sf::Vector2f scale) {
+    defaultContext().setInstanceScale(instance, scale);
+}
+
+void AnimationManager::setInstanceVisible(int instance, bool visible) {
+    defaultContext().setInstanceVisible(instance, visible);
+}
+
+void AnimationManager::drawAll(sf::RenderTarget &target, sf::RenderStates states) {
+    defaultContext().drawAll(target, states);
+}
+
+void AnimationManager::drawAllPipelined(sf::RenderTarget &target, sf::RenderStates states) {
+    defaultContext().drawAllPipelined(target, states);
+}
+
+AnimationManager::DrawTimings AnimationManager::getDrawTimings() {
+    return defaultContext().getDrawTimings();
+}
+
+void AnimationManager::resetDrawTimings() {
+    defaultContext().resetDrawTimings();
+}
+
+AnimationManager::Stats AnimationManager::getStats() {
+    return defaultContext().getStats();
+}
+
+void AnimationManager::resetStats() {
+    defaultContext().resetStats();
+}
+
+AnimationManager::DrawStats AnimationManager::getFrameDrawStats() {
+    return defaultContext().getFrameDrawStats();
+}
+
+AnimationManager::MemoryUsage AnimationManager::getMemoryUsage() {
+    return defaultContext().getMemoryUsage();
+}
+
+AnimationManager::MemoryUsage AnimationManager::getMemoryUsage(const std::string &animation) {
+    return defaultContext().getMemoryUsage(animation);
+}
+
+void AnimationManager::getClipInstances(std::vector<ClipInstances> &clips) {
+    defaultContext().getClipInstances(clips);
+}
+
+int AnimationManager::addStateMachine(const AnimationStateMachine &stateMachine) {
+    return defaultContext().addStateMachine(stateMachine);
+}
+
+int AnimationManager::createStateMachineInstance(int stateMachine) {
+    return defaultContext().createStateMachineInstance(stateMachine);
+}
+
+void AnimationManager::setInstanceParameter(int instance, int parameter, float value) {
+    defaultContext().setInstanceParameter(instance, parameter, value);
+}
+
+int AnimationManager::getInstanceState(int instance) {
+    return defaultContext().getInstanceState(instance);
+}
+
+void AnimationManager::applyInstance(int instance, sf::Sprite &sprite) {
+    defaultContext().applyInstance(instance, sprite);
+}
+
+void AnimationManager::drainEvents(std::vector<AnimationEvent> &events) {
+    defaultContext().drainEvents(events);
+}
@@ -1,42 +1,89 @@
 #pragma once
-#include <SFML/Graphics.hpp>
-#include <map>
-#include <string>
+#include "AnimationContext.h"
 
 // This header file defines the AnimationManager class, which manages animations
 // for game sprites using the SFML Graphics library. The class provides functions to:
 // - Add, update, and delete animations.
 // - Set various animation properties such as frequency, sprite size, sheet size, and indices.
-// - Store animation data in static member variables (textures, indices, sizes, frequencies, etc.).
-// The class includes several private static member variables to store animation data
-// and public static member functions to manage animations.
+// - Give individual frames their own durations and seek to any point in an animation.
+// - Play animations once, looped, ping-ponged or reversed.
+// - Create many independent instances of an animation and update them all in one call.
+// - Mark frames of an animation and collect the markers reached by instances as a batch of events.
+// - Drive instances with state machines compiled into flat transition tables.
+// - Crossfade instances between animations and draw all instances in one call per texture.
+// - Control instances from other threads through a lock-free command queue.
+// - Spawn and destroy instances from worker threads through per-thread shards merged by updateAll.
+// - Draw on another thread than the one updating, from triple-buffered frame records.
+// - Generate the vertices of the next batch on a worker while the current one is drawn.
+// - Spread updateAll over worker threads through a work-stealing job system.
+// - Add animations from a streaming thread while instances are created and updated, a chunk at a time.
+// - Count updated instances, advanced frames, events and misses without contention between threads.
+// - Count the draw calls, texture switches, vertices and batch breaks of each frame drawn.
+// - Report the memory used by textures, clips, frame tables, instances and names.
+// - Update instances in priority order within a time budget, catching deferred ones up later.
+// The class is a set of static member functions that forward to a default AnimationContext,
+// for programs that only need one; scenes that need their own state create contexts directly.
 
 class AnimationManager {
-private:
-    // Static member variables to store animation data
-    static std::map<std::string, sf::Texture> m_textures;      // Textures of animations
-    static std::map<std::string, sf::Vector2i> m_indices;      // Current indices of animations
-    static std::map<std::string, sf::Vector2i> m_startingIndices; // Starting indices of animations
-    static std::map<std::string, sf::Vector2i> m_endingIndices; // Ending indices of animations
-    static std::map<std::string, sf::Vector2i> m_sheetSizes;   // Sizes of animation sheets
-    static std::map<std::string, sf::Vector2i> m_spriteSizes;  // Sizes of animation sprites
-    static std::map<std::string, int> m_frequencies;           // Frequencies of updates
-    static std::map<std::string, int> m_timesUpdated;          // Times updated counters
-
 public:
+    // Types and constants shared with AnimationContext
+    using PlaybackMode = AnimationContext::PlaybackMode;
+    using AnimationEvent = AnimationContext::AnimationEvent;
+    using DrawTimings = AnimationContext::DrawTimings;
+    using Stats = AnimationContext::Stats;
+    using DrawStats = AnimationContext::DrawStats;
+    using MemoryUsage = AnimationContext::MemoryUsage;
+    using ClipInstances = AnimationContext::ClipInstances;
+    using AnimationDefinition = AnimationContext::AnimationDefinition;
+    static const int FinishedMarker = AnimationContext::FinishedMarker;
+    static const int DestroyedMarker = AnimationContext::DestroyedMarker;
+    static const int MaxInstances = AnimationContext::MaxInstances;
+    static const int StateMachineParameters = AnimationContext::StateMachineParameters;
+
+    // Function to get the context the static functions work on
+    static AnimationContext &defaultContext();
+
     // Function to update the animation frame for a specific sprite
-    static void update(const std::string &animation, sf::Sprite &sprite);
+    static void update(std::string_view animation, sf::Sprite &sprite);
 
     // Function to update all animations in a given map of sprites
     static void updateAll(std::map<std::string, sf::Sprite> &map);
 
+    // Function to advance every active instance by one update call. Built with ANIMATION_PARALLEL_STL defined,
+    // it runs chunks of instances through the standard parallel algorithms, with the same results.
+    static void updateAll();
+
+    // Function to advance every active instance like updateAll(), running chunks of grainSize instances as jobs.
+    // The results and the order of the events are the same as with updateAll().
+    static void updateAll(AnimationJobSystem &jobs, int grainSize = 256);
+
+    // Function to advance the active instances in priority order until the time budget runs out, deferring the
+    // rest to the next update (returns the number deferred)
+    static int updateAllBudgeted(double budgetMilliseconds);
+
+    // Function to set the priority level of an instance for updateAllBudgeted, from 0 (advanced first) to 3
+    static void setInstancePriority(int instance, int priority);
+
+    // Function to get the number of instances the last budgeted update deferred
+    static int getDeferredCount();
+
     // Function to add a new animation with the specified parameters
     static void addAnimation(const std::string &animation, const sf::Texture &texture,
                              sf::Vector2i sheetSize, sf::Vector2i spriteSize,
                              sf::Vector2i index = {0, 0}, int frequency = 0,
                              sf::Vector2i startingIndex = {0, 0});
 
-    // Function to delete an existing animation
+    // Function to add a new animation that shares the texture of an existing one, so both are drawn in one batch
+    static void addAnimation(const std::string &animation, const std::string &textureAnimation,
+                             sf::Vector2i sheetSize, sf::Vector2i spriteSize,
+                             sf::Vector2i index = {0, 0}, int frequency = 0,
+                             sf::Vector2i startingIndex = {0, 0});
+
+    // Function to add a chunk of animations at once, publishing their names together
+    static void addAnimations(const std::vector<AnimationDefinition> &animations);
+
+    // Function to delete an existing animation (and any instances playing it). Animations used by a state
+    // machine are kept, as its compiled states refer to them by clip id.
     static void deleteAnimation(const std::string &animation);
 
     // Setter functions to modify animation properties
@@ -47,7 +94,113 @@ public:
     static void setAnimationTexture(const std::string &animation, const sf::Texture &texture);
     static void setAnimationStartingIndex(const std::string &animation, sf::Vector2i index);
     static void setAnimationEndingIndex(const std::string &animation, sf::Vector2i index);
+    static void setAnimationPlaybackMode(const std::string &animation, PlaybackMode mode);
+
+    // Function to give each frame its own duration in update calls (an empty list restores the frequency)
+    static void setAnimationFrameDurations(const std::string &animation, const std::vector<int> &durations);
+
+    // Function to mark a frame (counted from the starting index) and return the marker's id
+    static int addAnimationMarker(const std::string &animation, int frame, const std::string &marker);
+
+    // Function to remove every marker of an animation
+    static void clearAnimationMarkers(const std::string &animation);
+
+    // Function to look up the id of a marker name (returns -1 if it was never added)
+    static int getMarkerId(const std::string &marker);
+
+    // Function to jump an animation to the frame shown after the given number of update calls
+    static void seekAnimation(const std::string &animation, int elapsed);
 
     // Function to reset the animation index to the starting index
     static void resetAnimationIndex(const std::string &animation);
-};
\ No newline at end of file
+
+    // Functions to create and destroy independent instances of an animation (returns -1 if not found). Every
+    // function taking a handle ignores one whose instance was destroyed or released.
+    static int createInstance(const std::string &animation);
+    static int createInstance(const std::string &animation, PlaybackMode mode);
+    static void destroyInstance(int instance);
+
+    // Function to play an instance again from its first frame
+    static void restartInstance(int instance);
+
+    // Function to hold an instance on its current frame until it is restarted
+    static void stopInstance(int instance);
+
+    // Function to jump an instance to the frame shown after the given number of update calls
+    static void seekInstance(int instance, int elapsed);
+
+    // Function to set how many update calls an instance advances per updateAll (1 by default)
+    static void setInstanceSpeed(int instance, float speed);
+
+    // Function to check whether an instance is still being advanced by updateAll
+    static bool isInstanceActive(int instance);
+
+    // Function to look up the clip id of an animation, for queueSpawn (returns -1 if not found)
+    static int getAnimationId(const std::string &animation);
+
+    // Functions any thread can call to control instances. The commands run at the start of the next
+    // updateAll, in the order each thread posted them, and return false (or -1) if the queue is full.
+    // A command for an instance destroyed or released before it runs is dropped, even if its index was reused.
+    static bool queuePlay(int instance);
+    static bool queueStop(int instance);
+    static bool queueSeek(int instance, int elapsed);
+    static bool queueSetSpeed(int instance, float speed);
+    static int queueSpawn(int animationId, PlaybackMode mode = PlaybackMode::Loop);
+    static bool queueDestroy(int instance);
+
+    // Function to create a shard through which one worker thread spawns and destroys instances without
+    // contending with other threads, merged at the start of each updateAll. Call it from the updating thread.
+    static AnimationSpawnShard &createSpawnShard(std::size_t capacity = 4096);
+
+    // Function to switch an instance to another animation, fading out of its current frame over the given update calls
+    static void crossfadeInstance(int instance, const std::string &animation, int duration);
+
+    // Functions to place instances for drawAll
+    static void setInstancePosition(int instance, sf::Vector2f position);
+    static void setInstanceScale(int instance, sf::Vector2f scale);
+    static void setInstanceVisible(int instance, bool visible);
+
+    // Function to draw every visible instance with one draw call per texture, as of the last updateAll.
+    // It only reads the published frame, so it may run on another thread concurrently with updateAll.
+    static void drawAll(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default);
+
+    // Function to draw like drawAll, with a worker generating the vertices of the next segment of up to
+    // 2048 quads while the current one is drawn. Segments of one texture are drawn with one call each.
+    static void drawAllPipelined(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default);
+
+    // Functions to get and reset the times accumulated by drawAllPipelined
+    static DrawTimings getDrawTimings();
+    static void resetDrawTimings();
+
+    // Functions to get the counters summed over all threads since the last reset, and to reset them
+    static Stats getStats();
+    static void resetStats();
+
+    // Function to get the draw calls, texture switches, vertices and batch breaks of the latest frame drawn
+    static DrawStats getFrameDrawStats();
+
+    // Functions to get the memory used by the default context, or by one animation and the instances playing it
+    static MemoryUsage getMemoryUsage();
+    static MemoryUsage getMemoryUsage(const std::string &animation);
+
+    // Function to count the instances of every animation and how many of them are active
+    static void getClipInstances(std::vector<ClipInstances> &clips);
+
+    // Function to compile a state machine into transition tables (returns its id, or -1 on error)
+    static int addStateMachine(const AnimationStateMachine &stateMachine);
+
+    // Function to create an instance that starts in the initial state of a state machine
+    static int createStateMachineInstance(int stateMachine);
+
+    // Function to set a state machine parameter of an instance
+    static void setInstanceParameter(int instance, int parameter, float value);
+
+    // Function to get the state an instance is in (returns -1 if it has no state machine)
+    static int getInstanceState(int instance);
+
+    // Function to copy the current frame of an instance onto a sprite
+    static void applyInstance(int instance, sf::Sprite &sprite);
+
+    // Function to hand the events recorded by updateAll to the caller, leaving the internal buffer empty
+    static void drainEvents(std::vector<AnimationEvent> &events);
+};
@@ -0,0 +1,145 @@
+#include "AnimationProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationProfiler class. Every sample goes to the bucket of its highest set bit, so
+// the histograms have a fixed size, need no configuration and keep a relative error of at most
+// a factor of two, which is enough to tell a stalled frame from a normal one. All counters are
+// updated with relaxed atomics: a histogram read during an update may miss its latest samples.
+
+AnimationProfiler::PhaseCounters AnimationProfiler::s_phases[static_cast<int>(Phase::Count)];
+
+namespace {
+    // Function to get the path dumpAtExit writes to, created before the exit handler is registered
+    std::string &exitDumpPath() {
+        static std::string path;
+        return path;
+    }
+
+    // Function run at exit by dumpAtExit
+    void dumpOnExit() {
+        const std::string &path = exitDumpPath();
+        if (path.empty()) {
+            AnimationProfiler::dump(std::cerr);
+            return;
+        }
+        std::ofstream file(path);
+        if (!file) {
+            // Output an error message if the file cannot be written
+            std::cerr << "Cannot write animation profile to \"" << path << "\"!" << std::endl;
+            return;
+        }
+        AnimationProfiler::dump(file);
+    }
+}
+
+AnimationProfiler::ScopedTimer::~ScopedTimer() {
+    const auto elapsed = std::chrono::steady_clock::now() - m_start;
+    record(m_phase, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+}
+
+double AnimationProfiler::Histogram::meanMicroseconds() const {
+    return samples > 0 ? static_cast<double>(totalNanoseconds) / static_cast<double>(samples) / 1000.0 : 0.0;
+}
+
+double AnimationProfiler::Histogram::percentileMicroseconds(double percentile) const {
+    if (samples == 0) {
+        return 0.0;
+    }
+
+    // Find the bucket the sample of that rank falls into and report its upper bound, capped at the maximum
+    const double rank = percentile / 100.0 * static_cast<double>(samples);
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < Buckets; ++bucket) {
+        seen += counts[bucket];
+        if (seen > 0 && static_cast<double>(seen) >= rank) {
+            const double upper = static_cast<double>(std::uint64_t(1) << (bucket + 1));
+            return std::min(upper, static_cast<double>(maxNanoseconds)) / 1000.0;
+        }
+    }
+    return static_cast<double>(maxNanoseconds) / 1000.0;
+}
+
+void AnimationProfiler::record(Phase phase, std::uint64_t nanoseconds) {
+    // Find the bucket of the duration's highest set bit
+    int bucket = 0;
+    while (bucket < Buckets - 1 && (nanoseconds >> (bucket + 1)) != 0) {
+        ++bucket;
+    }
+
+    // Count the sample and raise the maximum if it is the longest so far
+    PhaseCounters &counters = s_phases[static_cast<int>(phase)];
+    counters.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    counters.samples.fetch_add(1, std::memory_order_relaxed);
+    counters.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    std::uint64_t longest = counters.maxNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > longest &&
+           !counters.maxNanoseconds.compare_exchange_weak(longest, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+AnimationProfiler::Histogram AnimationProfiler::getHistogram(Phase phase) {
+    // Copy the counters of the phase
+    const PhaseCounters &counters = s_phases[static_cast<int>(phase)];
+    Histogram histogram;
+    for (int bucket = 0; bucket < Buckets; ++bucket) {
+        histogram.counts[bucket] = counters.counts[bucket].load(std::memory_order_relaxed);
+    }
+    histogram.samples = counters.samples.load(std::memory_order_relaxed);
+    histogram.totalNanoseconds = counters.totalNanoseconds.load(std::memory_order_relaxed);
+    histogram.maxNanoseconds = counters.maxNanoseconds.load(std::memory_order_relaxed);
+    return histogram;
+}
+
+const char *AnimationProfiler::getPhaseName(Phase phase) {
+    static const char *const names[] = {"update", "lookup", "updateAll", "commands", "advance",
+                                        "events", "stateMachines", "publish"};
+    const int index = static_cast<int>(phase);
+    return index >= 0 && index < static_cast<int>(Phase::Count) ? names[index] : "unknown";
+}
+
+void AnimationProfiler::reset() {
+    // Clear the counters of every phase
+    for (PhaseCounters &counters: s_phases) {
+        for (std::atomic<std::uint64_t> &count: counters.counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        counters.samples.store(0, std::memory_order_relaxed);
+        counters.totalNanoseconds.store(0, std::memory_order_relaxed);
+        counters.maxNanoseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AnimationProfiler::dump(std::ostream &out) {
+    // Write one row per phase that recorded samples, with times in microseconds
+    char row[160];
+    std::snprintf(row, sizeof(row), "%-14s %10s %10s %10s %10s %10s %10s\n", "phase", "samples", "mean",
+                  "p50", "p90", "p99", "max");
+    out << row;
+    for (int phase = 0; phase < static_cast<int>(Phase::Count); ++phase) {
+        const Histogram histogram = getHistogram(static_cast<Phase>(phase));
+        if (histogram.samples == 0) {
+            continue;
+        }
+        std::snprintf(row, sizeof(row), "%-14s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                      getPhaseName(static_cast<Phase>(phase)), static_cast<unsigned long long>(histogram.samples),
+                      histogram.meanMicroseconds(), histogram.percentileMicroseconds(50.0),
+                      histogram.percentileMicroseconds(90.0), histogram.percentileMicroseconds(99.0),
+                      static_cast<double>(histogram.maxNanoseconds) / 1000.0);
+        out << row;
+    }
+}
+
+void AnimationProfiler::dumpAtExit(const std::string &path) {
+    // Register the handler once; later calls only change the path
+    static bool registered = false;
+    exitDumpPath() = path;
+    if (!registered) {
+        registered = true;
+        std::atexit(dumpOnExit);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// This header file defines the AnimationProfiler class, which times the phases of update and updateAll
+// when the library is built with ANIMATION_PROFILING defined. The class provides functions to:
+// - Time a phase with a scoped timer that records its duration when it goes out of scope.
+// - Get a fixed-bucket latency histogram of each phase, with percentiles, at runtime.
+// - Write all histograms as a table, now or when the program exits.
+// Buckets double in width from one nanosecond, so recording is a few atomic adds and never allocates.
+// Without ANIMATION_PROFILING the timers compile to nothing and the histograms stay empty.
+
+class AnimationProfiler {
+public:
+    // Phases timed by the animation functions
+    enum class Phase {
+        Update,        // update for one sprite, including the name lookup
+        Lookup,        // Name lookup of update
+        UpdateAll,     // updateAll for the instances, all phases below included
+        Commands,      // Commands merged from the queue and the spawn shards
+        Advance,       // Update kernel over the active set, computing frames, rects and markers
+        Events,        // Joining the events recorded by the chunks of a parallel update
+        StateMachines, // State machine transitions
+        Publish,       // Writing and publishing the frame records read by drawAll
+        Count          // Number of phases
+    };
+
+    // Number of buckets of a histogram; bucket b counts durations from 2^b up to 2^(b+1) nanoseconds
+    static const int Buckets = 40;
+
+    // Durations recorded for one phase
+    struct Histogram {
+        std::uint64_t counts[Buckets] = {};  // Samples by bucket
+        std::uint64_t samples = 0;           // Samples recorded
+        std::uint64_t totalNanoseconds = 0;  // Sum of the samples
+        std::uint64_t maxNanoseconds = 0;    // Longest sample
+
+        // Function to get the mean duration in microseconds
+        double meanMicroseconds() const;
+
+        // Function to get the upper bound of the bucket holding the given percentile (0 to 100), in microseconds
+        double percentileMicroseconds(double percentile) const;
+    };
+
+    // Timer recording the time from its construction to its destruction into a phase's histogram
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Phase phase) : m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer();
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        Phase m_phase;                                 // Phase the time is recorded for
+        std::chrono::steady_clock::time_point m_start; // Time the timer was created
+    };
+
+    // Function to add one duration to a phase's histogram, from any thread
+    static void record(Phase phase, std::uint64_t nanoseconds);
+
+    // Function to get a copy of a phase's histogram
+    static Histogram getHistogram(Phase phase);
+
+    // Function to get the name of a phase
+    static const char *getPhaseName(Phase phase);
+
+    // Function to clear all histograms
+    static void reset();
+
+    // Function to write the count, mean, percentiles and maximum of every phase that recorded samples
+    static void dump(std::ostream &out);
+
+    // Function to dump the histograms when the program exits, to a file or to std::cerr if the path is empty
+    static void dumpAtExit(const std::string &path = "");
+
+private:
+    // Counters of one phase, alone on their cache lines so phases timed on different threads do not contend
+    struct alignas(64) PhaseCounters {
+        std::atomic<std::uint64_t> counts[Buckets];
+        std::atomic<std::uint64_t> samples;
+        std::atomic<std::uint64_t> totalNanoseconds;
+        std::atomic<std::uint64_t> maxNanoseconds;
+    };
+
+    static PhaseCounters s_phases[static_cast<int>(Phase::Count)]; // Counters by phase
+};
+
+// Macro timing the rest of the enclosing scope as a phase, or nothing without ANIMATION_PROFILING
+#ifdef ANIMATION_PROFILING
+#define ANIMATION_PROFILE_JOIN(name, line) name##line
+#define ANIMATION_PROFILE_NAME(name, line) ANIMATION_PROFILE_JOIN(name, line)
+#define ANIMATION_PROFILE_SCOPE(phase) \
+    AnimationProfiler::ScopedTimer ANIMATION_PROFILE_NAME(animationProfileTimer, __LINE__)(AnimationProfiler::Phase::phase)
+#else
+#define ANIMATION_PROFILE_SCOPE(phase)
+#endif
@@ -0,0 +1,198 @@
+#include "AnimationSequence.h"
+
+#ifdef __cpp_impl_coroutine
+#include <iostream>
+#include <new>
+
+// This implementation file provides the definitions for the member functions declared in the
+// AnimationSequence and AnimationScheduler classes. Waiting sequences are kept in one vector of
+// waiters linked per instance, so dispatch only looks at the waiters of each event's instance,
+// and freed waiters are reused, so waiting does not allocate once the vectors have grown.
+// Coroutine frames come from per-thread free lists of 64-byte size classes, refilled a block of
+// frames at a time; freed frames go back to the list of the thread that frees them and the blocks
+// are kept for the rest of the program, so a steady stream of sequences never reaches the heap.
+
+namespace {
+    const std::size_t FrameGranularity = 64;                                // Size step between frame size classes
+    const std::size_t FrameClasses = 32;                                    // Number of size classes
+    const std::size_t PooledFrameLimit = FrameGranularity * FrameClasses;   // Largest pooled frame
+    const std::size_t FramesPerBlock = 64;                                  // Frames allocated at once for a class
+
+    // Free frame of a size class, linked to the next one
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+
+    thread_local FreeFrame *t_freeFrames[FrameClasses] = {}; // Free frames of this thread by size class
+}
+
+void *AnimationSequence::promise_type::operator new(std::size_t size) {
+    // Leave frames too large for the pool to the heap
+    if (size > PooledFrameLimit) {
+        return ::operator new(size);
+    }
+
+    // Refill the size class with a new block of frames when it runs out
+    const std::size_t sizeClass = (size - 1) / FrameGranularity;
+    if (!t_freeFrames[sizeClass]) {
+        const std::size_t frameSize = (sizeClass + 1) * FrameGranularity;
+        char *block = static_cast<char *>(::operator new(frameSize * FramesPerBlock));
+        for (std::size_t i = FramesPerBlock; i-- > 0;) {
+            FreeFrame *frame = reinterpret_cast<FreeFrame *>(block + i * frameSize);
+            frame->next = t_freeFrames[sizeClass];
+            t_freeFrames[sizeClass] = frame;
+        }
+    }
+
+    // Take the first free frame of the class
+    FreeFrame *frame = t_freeFrames[sizeClass];
+    t_freeFrames[sizeClass] = frame->next;
+    return frame;
+}
+
+void AnimationSequence::promise_type::operator delete(void *frame, std::size_t size) {
+    // Hand heap frames back to the heap and pooled ones to their size class
+    if (size > PooledFrameLimit) {
+        ::operator delete(frame);
+        return;
+    }
+    const std::size_t sizeClass = (size - 1) / FrameGranularity;
+    FreeFrame *freed = static_cast<FreeFrame *>(frame);
+    freed->next = t_freeFrames[sizeClass];
+    t_freeFrames[sizeClass] = freed;
+}
+
+AnimationSequence::AnimationSequence(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+AnimationSequence::AnimationSequence(AnimationSequence &&other) noexcept : m_handle(other.m_handle) {
+    other.m_handle = nullptr;
+}
+
+AnimationSequence::~AnimationSequence() {
+    // Destroy the frame of a sequence that was never started
+    if (m_handle) {
+        m_handle.destroy();
+    }
+}
+
+AnimationScheduler::Awaiter::Awaiter(AnimationScheduler &scheduler, int instance, int marker, bool ready)
+    : m_scheduler(&scheduler), m_instance(instance), m_marker(marker), m_ready(ready) {}
+
+bool AnimationScheduler::Awaiter::await_ready() const noexcept {
+    return m_ready;
+}
+
+void AnimationScheduler::Awaiter::await_suspend(std::coroutine_handle<AnimationSequence::promise_type> handle) {
+    // Wait in the scheduler until the event is dispatched
+    m_scheduler->addWaiter(m_instance, m_marker, handle);
+}
+
+AnimationScheduler::AnimationScheduler(AnimationContext &context) : m_context(context) {}
+
+AnimationScheduler::~AnimationScheduler() {
+    // Destroy the frames of sequences still waiting
+    for (Handle handle: m_running) {
+        handle.destroy();
+    }
+}
+
+void AnimationScheduler::start(AnimationSequence sequence) {
+    // Take over the frame and remember it among the running sequences
+    Handle handle = sequence.m_handle;
+    if (!handle) {
+        return;
+    }
+    sequence.m_handle = nullptr;
+    handle.promise().slot = static_cast<int>(m_running.size());
+    m_running.push_back(handle);
+
+    // Run the sequence until it first waits
+    resume(handle);
+}
+
+void AnimationScheduler::dispatch(const std::vector<AnimationContext::AnimationEvent> &events) {
+    // Unlink the waiters matching each event, collecting their sequences; a destroyed instance ends every wait on it
+    for (const AnimationContext::AnimationEvent &event: events) {
+        const int index = event.instance & (AnimationContext::MaxInstances - 1);
+        if (event.instance < 0 || index >= static_cast<int>(m_instanceWaiters.size())) {
+            continue;
+        }
+        int *link = &m_instanceWaiters[index];
+        while (*link != -1) {
+            const int waiter = *link;
+            if (m_waiters[waiter].instance == event.instance &&
+                (m_waiters[waiter].marker == event.marker || event.marker == AnimationContext::DestroyedMarker)) {
+                m_ready.push_back(m_waiters[waiter].handle);
+                *link = m_waiters[waiter].next;
+                m_freeWaiters.push_back(waiter);
+            } else {
+                link = &m_waiters[waiter].next;
+            }
+        }
+    }
+
+    // Resume the sequences in event order, once the links are no longer being walked
+    for (std::size_t i = 0; i < m_ready.size(); ++i) {
+        resume(m_ready[i]);
+    }
+    m_ready.clear();
+}
+
+AnimationScheduler::Awaiter AnimationScheduler::finished(int instance) {
+    // An inactive instance has finished (or was stopped) already, so its event would never come
+    return Awaiter(*this, instance, AnimationContext::FinishedMarker, !m_context.isInstanceActive(instance));
+}
+
+AnimationScheduler::Awaiter AnimationScheduler::marker(int instance, const std::string &marker) {
+    // Look up the marker, going on at once rather than waiting forever for an unknown one
+    const int id = m_context.getMarkerId(marker);
+    if (id < 0) {
+        std::cerr << "No marker found for \"" << marker << "\"!" << std::endl;
+    }
+    return Awaiter(*this, instance, id, id < 0 || instance < 0);
+}
+
+AnimationScheduler::Awaiter AnimationScheduler::marker(int instance, int marker) {
+    return Awaiter(*this, instance, marker, instance < 0);
+}
+
+std::size_t AnimationScheduler::getRunningCount() const {
+    return m_running.size();
+}
+
+void AnimationScheduler::addWaiter(int instance, int marker, Handle handle) {
+    // Make room for the list of the instance's index, which waiters on older handles of the index may still share
+    const int index = instance & (AnimationContext::MaxInstances - 1);
+    if (index >= static_cast<int>(m_instanceWaiters.size())) {
+        m_instanceWaiters.resize(index + 1, -1);
+    }
+
+    // Reuse a freed waiter if there is one, and put it at the front of the instance's list
+    int waiter;
+    if (!m_freeWaiters.empty()) {
+        waiter = m_freeWaiters.back();
+        m_freeWaiters.pop_back();
+    } else {
+        waiter = static_cast<int>(m_waiters.size());
+        m_waiters.emplace_back();
+    }
+    m_waiters[waiter] = {instance, marker, handle, m_instanceWaiters[index]};
+    m_instanceWaiters[index] = waiter;
+}
+
+void AnimationScheduler::resume(Handle handle) {
+    // Run the sequence until it waits again or finishes
+    handle.resume();
+    if (!handle.done()) {
+        return;
+    }
+
+    // Remove the finished sequence from the running ones and free its frame
+    const int slot = handle.promise().slot;
+    m_running[slot] = m_running.back();
+    m_running[slot].promise().slot = slot;
+    m_running.pop_back();
+    handle.destroy();
+}
+
+#endif
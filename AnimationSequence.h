@@ -0,0 +1,124 @@
+#pragma once
+#include "AnimationManager.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+
+// This header file defines AnimationSequence, the return type of coroutines that script animations,
+// and AnimationScheduler, which resumes them from the events drained after updateAll. They provide functions to:
+// - Wait until an instance finishes with co_await scheduler.finished(instance).
+// - Wait until an instance reaches a marked frame with co_await scheduler.marker(instance, "hit").
+// - Run thousands of sequences at once, with coroutine frames taken from a pool instead of the heap.
+// The sequences are resumed on the thread that calls dispatch, in the order of the events.
+// Both classes need C++20 coroutines and are left out of builds without them.
+
+class AnimationScheduler;
+
+class AnimationSequence {
+public:
+    struct promise_type {
+        int slot = -1; // Position in the scheduler's running sequences
+
+        AnimationSequence get_return_object() {
+            return AnimationSequence(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { throw; }
+
+        // Functions to take coroutine frames from the pool instead of the heap
+        static void *operator new(std::size_t size);
+        static void operator delete(void *frame, std::size_t size);
+    };
+
+    // Constructors and destructor; a sequence that was never started destroys its frame
+    AnimationSequence(AnimationSequence &&other) noexcept;
+    AnimationSequence(const AnimationSequence &) = delete;
+    AnimationSequence &operator=(const AnimationSequence &) = delete;
+    ~AnimationSequence();
+
+private:
+    friend class AnimationScheduler;
+
+    explicit AnimationSequence(std::coroutine_handle<promise_type> handle);
+
+    std::coroutine_handle<promise_type> m_handle; // Frame of the coroutine, until it is started
+};
+
+class AnimationScheduler {
+public:
+    // Value returned by finished and marker, suspending the sequence until the event is dispatched
+    class Awaiter {
+    public:
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<AnimationSequence::promise_type> handle);
+        void await_resume() const noexcept {}
+
+    private:
+        friend class AnimationScheduler;
+
+        Awaiter(AnimationScheduler &scheduler, int instance, int marker, bool ready);
+
+        AnimationScheduler *m_scheduler; // Scheduler the sequence waits in
+        int m_instance;                  // Instance the sequence waits for
+        int m_marker;                    // Marker id the sequence waits for
+        bool m_ready;                    // Whether the sequence can go on without waiting
+    };
+
+    // Constructor taking the context whose instances the sequences wait for
+    explicit AnimationScheduler(AnimationContext &context = AnimationManager::defaultContext());
+
+    // Destructor destroying the frames of sequences still waiting
+    ~AnimationScheduler();
+
+    AnimationScheduler(const AnimationScheduler &) = delete;
+    AnimationScheduler &operator=(const AnimationScheduler &) = delete;
+
+    // Function to take over a sequence and run it until its first co_await
+    void start(AnimationSequence sequence);
+
+    // Function to resume the sequences waiting for any of the events, usually those drained after updateAll.
+    // A sequence waits again from the next dispatch, even if a later event in the same batch would match.
+    // Every sequence waiting on an instance is resumed when the instance is destroyed, whatever it waits for.
+    void dispatch(const std::vector<AnimationContext::AnimationEvent> &events);
+
+    // Function to wait until an instance finishes (does not wait if the instance is already inactive)
+    Awaiter finished(int instance);
+
+    // Functions to wait until an instance reaches a frame with the marker (does not wait for unknown markers)
+    Awaiter marker(int instance, const std::string &marker);
+    Awaiter marker(int instance, int marker);
+
+    // Function to get the number of sequences started and not yet finished
+    std::size_t getRunningCount() const;
+
+private:
+    using Handle = std::coroutine_handle<AnimationSequence::promise_type>;
+
+    // Sequence waiting for an event, linked to the other waiters on the same instance
+    struct Waiter {
+        int instance;  // Handle of the instance the sequence waits for
+        int marker;    // Marker id the sequence waits for
+        Handle handle; // Suspended sequence
+        int next;      // Next waiter on the same instance (-1 if none)
+    };
+
+    // Function to add a waiter to the list of its instance
+    void addWaiter(int instance, int marker, Handle handle);
+
+    // Function to resume a sequence and destroy its frame once it has finished
+    void resume(Handle handle);
+
+    AnimationContext &m_context;       // Context whose instances are waited for
+    std::vector<Handle> m_running;     // Sequences started and not yet finished
+    std::vector<Waiter> m_waiters;     // Waiters, including freed ones
+    std::vector<int> m_freeWaiters;    // Positions of freed waiters
+    std::vector<int> m_instanceWaiters; // First waiter of each instance index (-1 if none)
+    std::vector<Handle> m_ready;       // Sequences to resume in the current dispatch
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include "AnimationSpawnShard.h"
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationSpawnShard class. The shard's thread is the only producer of the command ring
+// and the only consumer of the handle ring; updateAll is the other side of both, so neither
+// needs more than a load and a store of each ring's positions.
+
+AnimationSpawnShard::AnimationSpawnShard(std::atomic<int> &nextInstance, std::size_t capacity)
+    : m_nextInstance(nextInstance), m_commands(capacity), m_handles(capacity) {}
+
+int AnimationSpawnShard::spawn(int animationId, AnimationContext::PlaybackMode mode) {
+    // Check for room first, so a handle is never taken for a spawn that cannot be queued
+    if (m_commands.full()) {
+        return -1;
+    }
+
+    // Reuse a handle updateAll freed for the shard, or reserve a new one if none is left and there is room
+    int instance;
+    if (!m_handles.pop(instance)) {
+        instance = m_nextInstance.fetch_add(1);
+        if (instance >= AnimationContext::MaxInstances) {
+            return -1;
+        }
+    }
+
+    // Queue the creation of the instance
+    m_commands.push({AnimationCommand::Type::Spawn, instance, animationId, static_cast<int>(mode), 0.f});
+    return instance;
+}
+
+bool AnimationSpawnShard::destroy(int instance) {
+    // Queue the destruction of the instance
+    return m_commands.push({AnimationCommand::Type::Destroy, instance, 0, 0, 0.f});
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "AnimationContext.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// This header file defines the AnimationSpawnShard class, through which one worker thread creates and
+// destroys instances of an AnimationContext without contending with other threads. The class provides functions to:
+// - Spawn an instance of an animation and get its handle at once.
+// - Destroy an instance spawned or created earlier.
+// Each shard has two single-producer single-consumer rings shared only with the thread running
+// updateAll: one carries the worker's spawns and destroys, which updateAll merges into the context
+// at its start, and the other carries freed handles back to the worker, so short-lived instances
+// reuse indices instead of growing the instance arrays. A reused index comes with a new handle, so
+// destroying an instance that is already gone never reaches the instance that reused its index.
+
+class AnimationSpawnShard {
+public:
+    // Function to spawn an instance of an animation by clip id, from the shard's thread. The handle can be used
+    // right away; the instance starts playing at the next updateAll. Returns -1 if the shard is full or the
+    // context already gave out MaxInstances indices.
+    int spawn(int animationId, AnimationContext::PlaybackMode mode = AnimationContext::PlaybackMode::Loop);
+
+    // Function to destroy an instance at the next updateAll, from the shard's thread (returns false if the shard is
+    // full). Nothing is destroyed if the instance was destroyed or released before, even if its index was reused.
+    bool destroy(int instance);
+
+    AnimationSpawnShard(const AnimationSpawnShard &) = delete;
+    AnimationSpawnShard &operator=(const AnimationSpawnShard &) = delete;
+
+private:
+    friend class AnimationContext;
+
+    // Bounded ring with one producing and one consuming thread
+    template <typename T>
+    class Ring {
+    public:
+        // Constructor taking the number of slots, rounded up to a power of two
+        explicit Ring(std::size_t capacity) {
+            std::size_t size = 2;
+            while (size < capacity) {
+                size *= 2;
+            }
+            m_items.reset(new T[size]);
+            m_mask = size - 1;
+        }
+
+        // Function to add an item from the producing thread (returns false if the ring is full)
+        bool push(const T &item) {
+            const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+                return false;
+            }
+            m_items[tail & m_mask] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Function to take the oldest item from the consuming thread (returns false if the ring is empty)
+        bool pop(T &item) {
+            const std::size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = m_items[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Function to check from the producing thread whether a push would fail
+        bool full() const {
+            return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) > m_mask;
+        }
+
+        // Function to get the number of items, exact only on the producing or consuming thread
+        std::size_t size() const {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        // Function to get the number of slots
+        std::size_t capacity() const {
+            return m_mask + 1;
+        }
+
+    private:
+        std::unique_ptr<T[]> m_items;                  // Slots of the ring
+        std::size_t m_mask;                            // Capacity minus one, for wrapping positions
+        alignas(64) std::atomic<std::size_t> m_head{0}; // Next position the consumer reads from
+        alignas(64) std::atomic<std::size_t> m_tail{0}; // Next position the producer writes to
+    };
+
+    // Constructor taking the context's handle counter and the number of commands the shard holds between updates
+    AnimationSpawnShard(std::atomic<int> &nextInstance, std::size_t capacity);
+
+    std::atomic<int> &m_nextInstance;   // Counter of handles never given out, shared with the context
+    Ring<AnimationCommand> m_commands;  // Spawns and destroys waiting for the next updateAll
+    Ring<int> m_handles;                // Freed handles handed to the shard by updateAll, with their new generation
+};
@@ -0,0 +1,55 @@
+#include "AnimationStateMachine.h"
+#include <algorithm>
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationStateMachine class. The functions only record the description; the
+// compilation into transition tables happens in AnimationContext::addStateMachine.
+
+int AnimationStateMachine::addState(const std::string &animation, AnimationContext::PlaybackMode mode) {
+    // Add the state and return its index
+    m_animations.push_back(animation);
+    m_modes.push_back(mode);
+    m_blends.push_back(0);
+    return static_cast<int>(m_animations.size()) - 1;
+}
+
+int AnimationStateMachine::addParameter(const std::string &name, float value) {
+    // Add the parameter and return its index
+    m_parameterNames.push_back(name);
+    m_parameterValues.push_back(value);
+    return static_cast<int>(m_parameterNames.size()) - 1;
+}
+
+void AnimationStateMachine::addParameterTransition(int from, int to, int parameter, Comparison comparison,
+                                                   float threshold) {
+    // Add a transition taken when the comparison between the parameter and the threshold holds
+    m_transitions.push_back({from, to, static_cast<Condition>(comparison), parameter, threshold, {}});
+}
+
+void AnimationStateMachine::addMarkerTransition(int from, int to, const std::string &marker) {
+    // Add a transition taken when the state's animation reaches a frame with the marker
+    m_transitions.push_back({from, to, Condition::Marker, 0, 0.f, marker});
+}
+
+void AnimationStateMachine::addFinishedTransition(int from, int to) {
+    // Add a transition taken when the state's one-shot animation finishes
+    m_transitions.push_back({from, to, Condition::Finished, 0, 0.f, {}});
+}
+
+void AnimationStateMachine::setStateBlend(int state, int duration) {
+    // Set the crossfade duration used when entering the state
+    if (state >= 0 && state < static_cast<int>(m_blends.size())) {
+        m_blends[state] = duration;
+    }
+}
+
+void AnimationStateMachine::setInitialState(int state) {
+    // Set the state new instances start in
+    m_initialState = state;
+}
+
+int AnimationStateMachine::getParameterIndex(const std::string &name) const {
+    // Look up the parameter by name
+    auto parameter = std::find(m_parameterNames.begin(), m_parameterNames.end(), name);
+    return parameter != m_parameterNames.end() ? static_cast<int>(parameter - m_parameterNames.begin()) : -1;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "AnimationManager.h"
+#include <string>
+#include <vector>
+
+// This header file defines the AnimationStateMachine class, which describes how an animation
+// instance switches between animations. The class provides functions to:
+// - Add states, each playing one animation with a playback mode.
+// - Add float parameters that the game sets per instance.
+// - Add transitions taken when a parameter comparison holds, a marker is reached, or the
+//   state's animation finishes.
+// - Crossfade into a state instead of switching to it at once.
+// A state machine is only a description: AnimationContext::addStateMachine compiles it into
+// flat transition tables that updateAll evaluates for every instance in one pass.
+
+class AnimationStateMachine {
+public:
+    // Comparisons available for parameter transitions
+    enum class Comparison {
+        Less,
+        Greater,
+        Equal,
+        NotEqual
+    };
+
+    // Function to add a state playing the specified animation (returns the state's index)
+    int addState(const std::string &animation,
+                 AnimationContext::PlaybackMode mode = AnimationContext::PlaybackMode::Loop);
+
+    // Function to add a parameter with its initial value (returns the parameter's index)
+    int addParameter(const std::string &name, float value = 0.f);
+
+    // Functions to add transitions, which are checked in the order they were added
+    void addParameterTransition(int from, int to, int parameter, Comparison comparison, float threshold);
+    void addMarkerTransition(int from, int to, const std::string &marker);
+    void addFinishedTransition(int from, int to);
+
+    // Function to crossfade into a state over the given number of update calls instead of switching at once
+    void setStateBlend(int state, int duration);
+
+    // Function to choose the state new instances start in (the first state by default)
+    void setInitialState(int state);
+
+    // Function to look up the index of a parameter name (returns -1 if not found)
+    int getParameterIndex(const std::string &name) const;
+
+private:
+    friend class AnimationContext;
+
+    // Kinds of transition condition, parameter comparisons first so they match Comparison
+    enum class Condition {
+        Less,
+        Greater,
+        Equal,
+        NotEqual,
+        Marker,
+        Finished
+    };
+
+    // Description of a transition before it is compiled
+    struct Transition {
+        int from;           // State the transition leaves
+        int to;             // State the transition enters
+        Condition condition; // Condition that triggers the transition
+        int parameter;      // Parameter compared by parameter transitions
+        float threshold;    // Value the parameter is compared against
+        std::string marker; // Marker name of marker transitions
+    };
+
+    std::vector<std::string> m_animations;                    // Animations of the states
+    std::vector<AnimationContext::PlaybackMode> m_modes;      // Playback modes of the states
+    std::vector<int> m_blends;                                // Crossfade durations into the states
+    std::vector<std::string> m_parameterNames;                // Names of the parameters
+    std::vector<float> m_parameterValues;                     // Initial values of the parameters
+    std::vector<Transition> m_transitions;                    // Transitions in the order they were added
+    int m_initialState = 0;                                   // State new instances start in
+};
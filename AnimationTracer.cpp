@@ -0,0 +1,172 @@
+#include "AnimationTracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// This implementation file provides the definitions for the member functions declared
+// in the AnimationTracer class. A thread's ring is created the first time it records and kept
+// for the rest of the program, so its events can still be written after the thread has ended.
+// The recording thread is the only writer of its ring. It publishes the position it is about to
+// overwrite before writing an event and the position after it once written, so writeChromeTrace
+// can copy a ring while it is written to and drop whatever may have been overwritten meanwhile,
+// like a sequence lock that never makes the writer wait.
+
+std::atomic<bool> AnimationTracer::s_recording{false};
+
+namespace {
+    // Event in a ring; every field is atomic so a copy racing with the writer is only stale, never undefined
+    struct RingEvent {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<std::uint64_t> nanoseconds{0};
+        std::atomic<char> phase{0};
+    };
+
+    // Events recorded by one thread
+    struct ThreadRing {
+        int thread = 0;                            // Thread id written to the trace
+        std::atomic<std::uint64_t> started{0};     // Events the writer has started writing
+        std::atomic<std::uint64_t> written{0};     // Events the writer has finished writing
+        std::atomic<std::uint64_t> cleared{0};     // Events dropped by clear
+        RingEvent events[AnimationTracer::ThreadEvents]; // Slots, indexed by event count modulo their number
+    };
+
+    // Event copied out of a ring
+    struct CopiedEvent {
+        const char *name;
+        std::uint64_t nanoseconds;
+        char phase;
+    };
+
+    // Rings of all threads that have recorded, created on first use so they outlive every thread
+    struct TraceRings {
+        std::mutex mutex;                               // Guards the list, taken once per thread
+        std::vector<std::unique_ptr<ThreadRing>> rings; // Rings in the order threads first recorded
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now(); // Time zero of the trace
+    };
+
+    TraceRings &traceRings() {
+        static TraceRings rings;
+        return rings;
+    }
+
+    thread_local ThreadRing *t_ring = nullptr; // Ring of this thread, once it has recorded
+
+    // Function to get the calling thread's ring, creating it the first time
+    ThreadRing &threadRing() {
+        if (!t_ring) {
+            TraceRings &rings = traceRings();
+            std::lock_guard<std::mutex> lock(rings.mutex);
+            rings.rings.emplace_back(new ThreadRing());
+            t_ring = rings.rings.back().get();
+            t_ring->thread = static_cast<int>(rings.rings.size());
+        }
+        return *t_ring;
+    }
+
+    // Function to write a name as a JSON string
+    void writeJsonString(std::ostream &out, const char *text) {
+        out << '"';
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                out << '\\';
+            }
+            out << *text;
+        }
+        out << '"';
+    }
+}
+
+void AnimationTracer::start() {
+    traceRings(); // Fix the time zero before the first event
+    s_recording.store(true, std::memory_order_relaxed);
+}
+
+void AnimationTracer::stop() {
+    s_recording.store(false, std::memory_order_relaxed);
+}
+
+void AnimationTracer::record(const char *name, char phase) {
+    const auto elapsed = std::chrono::steady_clock::now() - traceRings().epoch;
+
+    // Announce the slot before overwriting it, then write the event and publish it
+    ThreadRing &ring = threadRing();
+    const std::uint64_t position = ring.written.load(std::memory_order_relaxed);
+    ring.started.store(position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    RingEvent &event = ring.events[position % ThreadEvents];
+    event.name.store(name, std::memory_order_relaxed);
+    event.nanoseconds.store(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    ring.written.store(position + 1, std::memory_order_release);
+}
+
+void AnimationTracer::clear() {
+    // Drop everything written so far; writers never look at this position
+    TraceRings &rings = traceRings();
+    std::lock_guard<std::mutex> lock(rings.mutex);
+    for (const std::unique_ptr<ThreadRing> &ring: rings.rings) {
+        ring->cleared.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+void AnimationTracer::writeChromeTrace(std::ostream &out) {
+    TraceRings &rings = traceRings();
+    std::lock_guard<std::mutex> lock(rings.mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::vector<CopiedEvent> events;
+    for (const std::unique_ptr<ThreadRing> &ring: rings.rings) {
+        // Copy the events still in the ring
+        const std::uint64_t end = ring->written.load(std::memory_order_acquire);
+        std::uint64_t begin = std::max(ring->cleared.load(std::memory_order_relaxed),
+                                       end > ThreadEvents ? end - ThreadEvents : 0);
+        events.clear();
+        for (std::uint64_t position = begin; position < end; ++position) {
+            const RingEvent &event = ring->events[position % ThreadEvents];
+            events.push_back({event.name.load(std::memory_order_relaxed),
+                              event.nanoseconds.load(std::memory_order_relaxed),
+                              event.phase.load(std::memory_order_relaxed)});
+        }
+
+        // Drop the copies of slots the writer may have started overwriting while they were copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t started = ring->started.load(std::memory_order_relaxed);
+        const std::uint64_t skip = started > ThreadEvents + begin ? started - ThreadEvents - begin : 0;
+
+        // Write the events, leaving out end events whose begin event is no longer in the ring
+        int depth = 0;
+        for (std::size_t index = static_cast<std::size_t>(std::min<std::uint64_t>(skip, events.size()));
+             index < events.size(); ++index) {
+            const CopiedEvent &event = events[index];
+            if (event.phase == 'E' && depth == 0) {
+                continue;
+            }
+            depth += event.phase == 'B' ? 1 : -1;
+            char fields[96];
+            std::snprintf(fields, sizeof(fields), ",\"cat\":\"animation\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                          event.phase, static_cast<double>(event.nanoseconds) / 1000.0, ring->thread);
+            out << (first ? "\n{\"name\":" : ",\n{\"name\":");
+            writeJsonString(out, event.name);
+            out << fields;
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool AnimationTracer::writeChromeTrace(const std::string &path) {
+    std::ofstream file(path);
+    if (!file) {
+        // Output an error message if the file cannot be written
+        std::cerr << "Cannot write animation trace to \"" << path << "\"!" << std::endl;
+        return false;
+    }
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// This header file defines the AnimationTracer class, which records when the animation functions begin
+// and end and writes them as Chrome trace-event JSON, to be opened in Perfetto or chrome://tracing.
+// The class provides functions to:
+// - Start and stop recording at any time; while stopped, a traced scope costs one atomic load.
+// - Mark a scope of one's own code with ANIMATION_TRACE_SCOPE, to see it next to the animation phases.
+// - Write the events recorded so far to a stream or a file, while recording goes on.
+// Each thread records into its own ring of events, written only by that thread, so recording takes no
+// locks. The rings have a fixed size and overwrite their oldest events, so tracing can stay on.
+
+class AnimationTracer {
+public:
+    // Events each thread keeps, before the oldest ones are overwritten
+    static const std::size_t ThreadEvents = 8192;
+
+    // Scope recording a begin event when created and the matching end event when destroyed
+    class Scope {
+    public:
+        explicit Scope(const char *name) : m_name(isRecording() ? name : nullptr) {
+            if (m_name) {
+                record(m_name, 'B');
+            }
+        }
+        ~Scope() {
+            if (m_name) {
+                record(m_name, 'E');
+            }
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *m_name; // Name of the scope, or nullptr if recording was off when it began
+    };
+
+    // Functions to start and stop recording on all threads
+    static void start();
+    static void stop();
+
+    // Function to check whether events are being recorded
+    static bool isRecording() {
+        return s_recording.load(std::memory_order_relaxed);
+    }
+
+    // Function to record a begin ('B') or end ('E') event on the calling thread. The name must outlive the tracer,
+    // like a string literal.
+    static void record(const char *name, char phase);
+
+    // Function to drop the events recorded so far
+    static void clear();
+
+    // Functions to write the events recorded so far as Chrome trace-event JSON (the file version returns false
+    // if the file cannot be written). End events whose begin event was overwritten are left out.
+    static void writeChromeTrace(std::ostream &out);
+    static bool writeChromeTrace(const std::string &path);
+
+private:
+    static std::atomic<bool> s_recording; // Whether scopes record events
+};
+
+// Macro tracing the rest of the enclosing scope under a name
+#define ANIMATION_TRACE_JOIN(name, line) name##line
+#define ANIMATION_TRACE_NAME(name, line) ANIMATION_TRACE_JOIN(name, line)
+#define ANIMATION_TRACE_SCOPE(name) AnimationTracer::Scope ANIMATION_TRACE_NAME(animationTraceScope, __LINE__)(name)
@@ -0,0 +1,626 @@
+#include "AnimationManager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// This harness answers how many animated objects fit in a frame budget without opening a window.
+// It builds a synthetic scene on the AnimationManager's default context, runs it for a number of
+// ticks and prints one CSV row with the throughput, the per-tick latency percentiles and the peak
+// heap use. Textures are default-constructed and nothing is drawn unless --draw is given, so no GL
+// context is created and the harness runs on servers without a GPU. Build it from the repository
+// root with, for example:
+//   g++ -std=c++17 -O2 -I. bench/HeadlessHarness.cpp *.cpp -lsfml-graphics -lsfml-window -lsfml-system -pthread
+// Usage: HeadlessHarness [--option value]...
+//   --name NAME        Label of the scene in the CSV row (default "scene")
+//   --clips N          Animations in the scene (default 16)
+//   --sheet WxH        Frames across and down each sprite sheet (default 8x8)
+//   --sprite WxH       Pixel size of a frame (default 32x32)
+//   --frequency N      Updates each frame is shown for (default 1)
+//   --markers N        Marked frames per clip, each recording an event when reached (default 0)
+//   --instances N      Instances created before the first tick (default 100000)
+//   --ticks N          Ticks measured (default 600)
+//   --warmup N         Ticks run before measuring, so buffers reach their steady size (default 60, or two
+//                      passes through a clip if those take longer, so one-shot populations settle first)
+//   --spawn N          Instances created on every tick (default 0)
+//   --despawn N        Instances destroyed on every tick, picked at random (default 0)
+//   --mode MODE        loop, once, oncerelease, pingpong, reverse or mixed (default loop)
+//   --workers N        Threads of a work-stealing pool, 0 for the serial updateAll (default 0)
+//   --grain N          Instances per job when workers are used (default 256)
+//   --seed N           Seed of the despawn picks (default 1)
+//   --draw KIND        Also draw every tick with drawAll (batched) or drawAllPipelined (pipelined) into a
+//                      render texture. This needs a GL context, so the run is no longer headless.
+//   --check-allocations Fail with exit code 1 if a measured tick allocates. Each tick then also updates one
+//                      sprite per clip by name. Use a scene whose population stops growing during the warm-up.
+//                      Allocations made while drawing are reported apart, as SFML may make some of them.
+//   --perf             Read the CPU's cycles, instructions, L1 data cache misses, last-level cache misses and
+//                      branch misses around the measured ticks (Linux only), reported per instance updated
+//   --no-header        Leave out the CSV header, to append rows of several runs
+//
+// Allocations are counted by replacing the global operator new and delete, and with glibc also malloc,
+// calloc, realloc and free. The library itself only allocates through operator new, so when drawing, the
+// allocation check ignores the malloc calls of the GL driver and only reports them.
+// Hardware counters are opened with perf_event_open for this process and the threads it starts afterwards,
+// user space only. A counter the kernel refuses, as in most containers or with a strict perf_event_paranoid,
+// is left empty in the row and the reason is printed once, so the rest of the run is unaffected.
+
+namespace {
+    // Heap use counted by the replaced operator new and delete
+    std::atomic<std::size_t> g_heapBytes{0};       // Bytes currently allocated
+    std::atomic<std::size_t> g_heapPeak{0};        // Most bytes allocated at once
+    std::atomic<long long> g_heapAllocations{0};   // Allocations made
+    std::atomic<long long> g_mallocCalls{0};       // Calls of malloc, calloc and realloc outside operator new
+
+    // Bytes kept in front of every block for its size, enough to keep the block aligned for any type
+    const std::size_t HeaderBytes = alignof(std::max_align_t);
+}
+
+#ifdef __GLIBC__
+// The C allocation functions are replaced by ones that count their calls and forward to glibc's own
+extern "C" {
+    void *__libc_malloc(std::size_t size);
+    void *__libc_calloc(std::size_t count, std::size_t size);
+    void *__libc_realloc(void *data, std::size_t size);
+    void __libc_free(void *data);
+
+    void *malloc(std::size_t size) {
+        g_mallocCalls.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+    void *calloc(std::size_t count, std::size_t size) {
+        g_mallocCalls.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+    void *realloc(void *data, std::size_t size) {
+        g_mallocCalls.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(data, size);
+    }
+    void free(void *data) {
+        __libc_free(data);
+    }
+}
+#endif
+
+namespace {
+    // Functions to take and give back the memory of operator new without counting it as a malloc call
+    void *rawAllocate(std::size_t size) {
+#ifdef __GLIBC__
+        return __libc_malloc(size);
+#else
+        return std::malloc(size);
+#endif
+    }
+
+    void rawFree(void *data) {
+#ifdef __GLIBC__
+        __libc_free(data);
+#else
+        std::free(data);
+#endif
+    }
+
+    // Function to count an allocation and raise the peak if it is the highest so far
+    void countAllocation(std::size_t size) {
+        const std::size_t current = g_heapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        std::size_t peak = g_heapPeak.load(std::memory_order_relaxed);
+        while (current > peak && !g_heapPeak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+        g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Functions to allocate and free a block with its size stored in front of it
+    void *allocateCounted(std::size_t size, std::size_t alignment) {
+        const std::size_t header = std::max(HeaderBytes, alignment);
+        void *block = alignment > HeaderBytes
+                      ? std::aligned_alloc(alignment, (header + size + alignment - 1) / alignment * alignment)
+                      : rawAllocate(header + size);
+        if (!block) {
+            return nullptr;
+        }
+        char *data = static_cast<char *>(block) + header;
+        std::memcpy(data - sizeof(std::size_t), &size, sizeof(std::size_t));
+        countAllocation(size);
+        return data;
+    }
+
+    void freeCounted(void *data, std::size_t alignment) {
+        if (!data) {
+            return;
+        }
+        std::size_t size;
+        std::memcpy(&size, static_cast<char *>(data) - sizeof(std::size_t), sizeof(std::size_t));
+        g_heapBytes.fetch_sub(size, std::memory_order_relaxed);
+        rawFree(static_cast<char *>(data) - std::max(HeaderBytes, alignment));
+    }
+
+    // Function to allocate for operator new, throwing like the default one when memory runs out
+    void *allocateOrThrow(std::size_t size, std::size_t alignment) {
+        void *data = allocateCounted(size ? size : 1, alignment);
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        return data;
+    }
+}
+
+void *operator new(std::size_t size) { return allocateOrThrow(size, HeaderBytes); }
+void *operator new[](std::size_t size) { return allocateOrThrow(size, HeaderBytes); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocateCounted(size ? size : 1, HeaderBytes); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocateCounted(size ? size : 1, HeaderBytes); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void operator delete(void *data) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete[](void *data) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete(void *data, std::size_t) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete[](void *data, std::size_t) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete(void *data, const std::nothrow_t &) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete[](void *data, const std::nothrow_t &) noexcept { freeCounted(data, HeaderBytes); }
+void operator delete(void *data, std::align_val_t alignment) noexcept { freeCounted(data, static_cast<std::size_t>(alignment)); }
+void operator delete[](void *data, std::align_val_t alignment) noexcept { freeCounted(data, static_cast<std::size_t>(alignment)); }
+void operator delete(void *data, std::size_t, std::align_val_t alignment) noexcept { freeCounted(data, static_cast<std::size_t>(alignment)); }
+void operator delete[](void *data, std::size_t, std::align_val_t alignment) noexcept { freeCounted(data, static_cast<std::size_t>(alignment)); }
+
+namespace {
+    // Parameters of a synthetic scene
+    struct SceneOptions {
+        std::string name = "scene";
+        int clips = 16;
+        sf::Vector2i sheet{8, 8};
+        sf::Vector2i sprite{32, 32};
+        int frequency = 1;
+        int markers = 0;
+        int instances = 100000;
+        int ticks = 600;
+        int warmup = -1;
+        int spawn = 0;
+        int despawn = 0;
+        std::string mode = "loop";
+        int workers = 0;
+        int grain = 256;
+        unsigned seed = 1;
+        std::string draw;
+        bool checkAllocations = false;
+        bool perf = false;
+        bool header = true;
+    };
+
+    // Function to read a size given as WxH (returns false if it is malformed)
+    bool parseSize(const char *text, sf::Vector2i &size) {
+        return std::sscanf(text, "%dx%d", &size.x, &size.y) == 2 && size.x > 0 && size.y > 0;
+    }
+
+    // Function to read the command line into the options (returns false after printing an error)
+    bool parseOptions(int argc, char *argv[], SceneOptions &options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (option == "--no-header") {
+                options.header = false;
+                continue;
+            }
+            if (option == "--check-allocations") {
+                options.checkAllocations = true;
+                continue;
+            }
+            if (option == "--perf") {
+                options.perf = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "Missing value for \"%s\"!\n", option.c_str());
+                return false;
+            }
+            const char *value = argv[++i];
+            if (option == "--name") {
+                options.name = value;
+            } else if (option == "--clips") {
+                options.clips = std::max(1, std::atoi(value));
+            } else if (option == "--sheet" || option == "--sprite") {
+                if (!parseSize(value, option == "--sheet" ? options.sheet : options.sprite)) {
+                    std::fprintf(stderr, "Invalid size \"%s\" for \"%s\"!\n", value, option.c_str());
+                    return false;
+                }
+            } else if (option == "--frequency") {
+                options.frequency = std::max(1, std::atoi(value));
+            } else if (option == "--markers") {
+                options.markers = std::max(0, std::atoi(value));
+            } else if (option == "--instances") {
+                options.instances = std::max(0, std::atoi(value));
+            } else if (option == "--ticks") {
+                options.ticks = std::max(1, std::atoi(value));
+            } else if (option == "--warmup") {
+                options.warmup = std::max(0, std::atoi(value));
+            } else if (option == "--spawn") {
+                options.spawn = std::max(0, std::atoi(value));
+            } else if (option == "--despawn") {
+                options.despawn = std::max(0, std::atoi(value));
+            } else if (option == "--mode") {
+                options.mode = value;
+            } else if (option == "--workers") {
+                options.workers = std::max(0, std::atoi(value));
+            } else if (option == "--grain") {
+                options.grain = std::max(1, std::atoi(value));
+            } else if (option == "--seed") {
+                options.seed = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--draw") {
+                options.draw = value;
+                if (options.draw != "batched" && options.draw != "pipelined") {
+                    std::fprintf(stderr, "Unknown kind of drawing \"%s\"!\n", value);
+                    return false;
+                }
+            } else {
+                std::fprintf(stderr, "Unknown option \"%s\"!\n", option.c_str());
+                return false;
+            }
+        }
+
+        // Warm up for two passes through a clip unless told otherwise, so one-shot instances have
+        // finished and been replaced at least once before measuring
+        if (options.warmup < 0) {
+            options.warmup = std::max(60, 2 * options.sheet.x * options.sheet.y * options.frequency);
+        }
+        return true;
+    }
+
+    // Function to get the playback mode of the n-th instance created (returns false if the mode is unknown)
+    bool playbackMode(const std::string &mode, int n, AnimationManager::PlaybackMode &result) {
+        using Mode = AnimationManager::PlaybackMode;
+        static const Mode mixed[] = {Mode::Loop, Mode::Once, Mode::OnceRelease, Mode::PingPong, Mode::Reverse};
+        if (mode == "mixed") {
+            result = mixed[n % 5];
+        } else if (mode == "loop") {
+            result = Mode::Loop;
+        } else if (mode == "once") {
+            result = Mode::Once;
+        } else if (mode == "oncerelease") {
+            result = Mode::OnceRelease;
+        } else if (mode == "pingpong") {
+            result = Mode::PingPong;
+        } else if (mode == "reverse") {
+            result = Mode::Reverse;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Instances the harness created and may destroy. OnceRelease instances give their handles back
+    // by themselves, so they are not kept: a later destroy of one would be dropped and despawn nothing.
+    class Population {
+    public:
+        Population(const SceneOptions &options, std::vector<std::string> clipNames)
+            : m_options(options), m_clipNames(std::move(clipNames)), m_random(options.seed) {
+            m_handles.reserve(static_cast<std::size_t>(options.instances) +
+                              static_cast<std::size_t>(options.spawn) * (options.warmup + options.ticks));
+        }
+
+        // Function to create an instance of the next clip, in the next playback mode
+        void spawn() {
+            AnimationManager::PlaybackMode mode;
+            playbackMode(m_options.mode, m_created, mode);
+            const std::string &clip = m_clipNames[static_cast<std::size_t>(m_created) % m_clipNames.size()];
+            const int instance = AnimationManager::createInstance(clip, mode);
+            ++m_created;
+            if (instance >= 0 && mode != AnimationManager::PlaybackMode::OnceRelease) {
+                m_handles.push_back(instance);
+            }
+        }
+
+        // Function to destroy an instance picked at random
+        void despawn() {
+            if (m_handles.empty()) {
+                return;
+            }
+            const std::size_t pick = std::uniform_int_distribution<std::size_t>(0, m_handles.size() - 1)(m_random);
+            AnimationManager::destroyInstance(m_handles[pick]);
+            m_handles[pick] = m_handles.back();
+            m_handles.pop_back();
+        }
+
+        // Function to run the spawns and despawns of one tick
+        void churn() {
+            for (int i = 0; i < m_options.spawn; ++i) {
+                spawn();
+            }
+            for (int i = 0; i < m_options.despawn; ++i) {
+                despawn();
+            }
+        }
+
+    private:
+        const SceneOptions &m_options;       // Scene being run
+        std::vector<std::string> m_clipNames; // Names of the clips, played in turn
+        std::vector<int> m_handles;           // Handles of the live instances the harness owns
+        std::mt19937 m_random;                // Generator of the despawn picks
+        int m_created = 0;                    // Instances created so far
+    };
+
+    // Hardware counters read around the measured ticks, each opened on its own so one the CPU or the kernel
+    // does not offer leaves the others working
+    class PerfCounters {
+    public:
+        static const int Count = 5;
+
+        // Function to get the CSV column of a counter
+        static const char *getColumn(int counter) {
+            static const char *const columns[Count] = {"cycles_per_instance", "instructions_per_instance",
+                                                       "l1d_misses_per_instance", "llc_misses_per_instance",
+                                                       "branch_misses_per_instance"};
+            return columns[counter];
+        }
+
+        PerfCounters() {
+            for (int &descriptor: m_descriptors) {
+                descriptor = -1;
+            }
+        }
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+        ~PerfCounters() {
+#ifdef __linux__
+            for (int descriptor: m_descriptors) {
+                if (descriptor >= 0) {
+                    close(descriptor);
+                }
+            }
+#endif
+        }
+
+        // Function to open the counters, disabled, before the worker threads are started so they are counted too
+        void open() {
+#ifdef __linux__
+            const std::uint32_t types[Count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                                PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+            const std::uint64_t configs[Count] = {
+                    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for (int counter = 0; counter < Count; ++counter) {
+                perf_event_attr attributes;
+                std::memset(&attributes, 0, sizeof(attributes));
+                attributes.size = sizeof(attributes);
+                attributes.type = types[counter];
+                attributes.config = configs[counter];
+                attributes.disabled = 1;
+                attributes.inherit = 1;
+                attributes.exclude_kernel = 1;
+                attributes.exclude_hv = 1;
+                attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                m_descriptors[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+                if (m_descriptors[counter] < 0) {
+                    std::fprintf(stderr, "Hardware counter \"%s\" unavailable: %s\n", getColumn(counter),
+                                 std::strerror(errno));
+                }
+            }
+#else
+            std::fprintf(stderr, "Hardware counters are only read on Linux\n");
+#endif
+        }
+
+        // Functions to start counting from zero and to stop counting
+        void start() {
+#ifdef __linux__
+            for (int descriptor: m_descriptors) {
+                if (descriptor >= 0) {
+                    ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        void stop() {
+#ifdef __linux__
+            for (int descriptor: m_descriptors) {
+                if (descriptor >= 0) {
+                    ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+                }
+            }
+#endif
+        }
+
+        // Function to read a counter, scaled up if the kernel multiplexed it (returns false if it was not counted)
+        bool read(int counter, double &value) const {
+#ifdef __linux__
+            std::uint64_t values[3]; // Count, time enabled, time running
+            if (m_descriptors[counter] < 0 ||
+                ::read(m_descriptors[counter], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) ||
+                values[2] == 0) {
+                return false;
+            }
+            value = static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+            return true;
+#else
+            (void) counter;
+            (void) value;
+            return false;
+#endif
+        }
+
+    private:
+        int m_descriptors[Count]; // File descriptors of the counters (-1 if not opened)
+    };
+
+    // Function to get a percentile (0 to 100) of sorted samples by the nearest rank
+    double percentile(const std::vector<double> &sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const std::size_t rank = static_cast<std::size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+}
+
+int main(int argc, char *argv[]) {
+    SceneOptions options;
+    AnimationManager::PlaybackMode mode;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+    if (!playbackMode(options.mode, 0, mode)) {
+        std::fprintf(stderr, "Unknown playback mode \"%s\"!\n", options.mode.c_str());
+        return 2;
+    }
+
+    // Build the clips, one sheet each, with the requested number of marked frames spread over the sheet
+    std::vector<std::unique_ptr<sf::Texture>> textures;
+    std::vector<std::string> clipNames;
+    const int frames = options.sheet.x * options.sheet.y;
+    for (int clip = 0; clip < options.clips; ++clip) {
+        textures.emplace_back(new sf::Texture());
+        clipNames.push_back("clip" + std::to_string(clip));
+        AnimationManager::addAnimation(clipNames.back(), *textures.back(), options.sheet, options.sprite,
+                                       {0, 0}, options.frequency);
+        for (int marker = 0; marker < std::min(options.markers, frames); ++marker) {
+            AnimationManager::addAnimationMarker(clipNames.back(), marker * frames / std::min(options.markers, frames),
+                                                 "marker");
+        }
+    }
+
+    // Create the starting population and the buffers reused by every tick
+    Population population(options, clipNames);
+    for (int instance = 0; instance < options.instances; ++instance) {
+        population.spawn();
+    }
+    PerfCounters perf;
+    if (options.perf) {
+        perf.open();
+    }
+    std::unique_ptr<AnimationWorkStealingPool> pool;
+    if (options.workers > 0) {
+        pool.reset(new AnimationWorkStealingPool(options.workers));
+    }
+    std::vector<AnimationManager::AnimationEvent> events;
+    std::vector<double> tickMicroseconds;
+    tickMicroseconds.reserve(static_cast<std::size_t>(options.ticks));
+    std::vector<sf::Sprite> sprites;
+    if (options.checkAllocations) {
+        sprites.reserve(textures.size());
+        for (const std::unique_ptr<sf::Texture> &texture: textures) {
+            sprites.emplace_back(*texture);
+        }
+    }
+    std::unique_ptr<sf::RenderTexture> target;
+    if (!options.draw.empty()) {
+        target.reset(new sf::RenderTexture());
+        if (!target->resize({1024, 1024})) {
+            std::fprintf(stderr, "Cannot create a render texture to draw into!\n");
+            return 2;
+        }
+    }
+
+    // Function to run one tick: the spawns and despawns, the update, the sprites updated by name when
+    // checking allocations (one of them from a string literal), draining the events and drawing
+    long long drawAllocations = 0;
+    auto tick = [&]() {
+        population.churn();
+        if (pool) {
+            AnimationManager::updateAll(*pool, options.grain);
+        } else {
+            AnimationManager::updateAll();
+        }
+        for (std::size_t clip = 0; clip < sprites.size(); ++clip) {
+            AnimationManager::update(clipNames[clip], sprites[clip]);
+        }
+        if (!sprites.empty()) {
+            AnimationManager::update("clip0", sprites[0]);
+        }
+        AnimationManager::drainEvents(events);
+        if (target) {
+            const long long drawAllocationsBefore = g_heapAllocations.load(std::memory_order_relaxed);
+            target->clear();
+            if (options.draw == "pipelined") {
+                AnimationManager::drawAllPipelined(*target);
+            } else {
+                AnimationManager::drawAll(*target);
+            }
+            target->display();
+            drawAllocations += g_heapAllocations.load(std::memory_order_relaxed) - drawAllocationsBefore;
+        }
+    };
+
+    for (int i = 0; i < options.warmup; ++i) {
+        tick();
+    }
+
+    // Time every tick on its own, counting only the work and allocations of the measured ticks
+    AnimationManager::resetStats();
+    drawAllocations = 0;
+    const long long allocationsBefore = g_heapAllocations.load(std::memory_order_relaxed);
+    const long long mallocCallsBefore = g_mallocCalls.load(std::memory_order_relaxed);
+    if (options.perf) {
+        perf.start();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.ticks; ++i) {
+        const auto tickStart = std::chrono::steady_clock::now();
+        tick();
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - tickStart;
+        tickMicroseconds.push_back(elapsed.count());
+    }
+    const std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    if (options.perf) {
+        perf.stop();
+    }
+    const long long allocations = g_heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+    const long long mallocCalls = g_mallocCalls.load(std::memory_order_relaxed) - mallocCallsBefore;
+    const AnimationManager::Stats stats = AnimationManager::getStats();
+    const AnimationManager::MemoryUsage usage = AnimationManager::getMemoryUsage();
+
+    // Write the row, with the latencies of the ticks in microseconds
+    std::vector<double> sorted = tickMicroseconds;
+    std::sort(sorted.begin(), sorted.end());
+    if (options.header) {
+        std::printf("scene,clips,sheet,instances,mode,spawn,despawn,workers,ticks,instances_updated,"
+                    "instances_per_second,ticks_per_second,mean_us,p50_us,p90_us,p99_us,max_us,"
+                    "events,allocations_per_tick,peak_heap_bytes,context_bytes");
+        for (int counter = 0; counter < PerfCounters::Count; ++counter) {
+            std::printf(",%s", PerfCounters::getColumn(counter));
+        }
+        std::printf("\n");
+    }
+    std::printf("%s,%d,%dx%d,%d,%s,%d,%d,%d,%d,%lld,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%lld,%.2f,%zu,%zu",
+                options.name.c_str(), options.clips, options.sheet.x, options.sheet.y, options.instances,
+                options.mode.c_str(), options.spawn, options.despawn, options.workers, options.ticks,
+                stats.instancesUpdated, static_cast<double>(stats.instancesUpdated) / total.count(),
+                options.ticks / total.count(), total.count() * 1e6 / options.ticks, percentile(sorted, 50.0),
+                percentile(sorted, 90.0), percentile(sorted, 99.0), sorted.back(), stats.eventsEmitted,
+                static_cast<double>(allocations) / options.ticks, g_heapPeak.load(std::memory_order_relaxed),
+                usage.total());
+
+    // Add the hardware counters per instance updated, leaving the columns of those not read empty
+    for (int counter = 0; counter < PerfCounters::Count; ++counter) {
+        double value;
+        if (options.perf && stats.instancesUpdated > 0 && perf.read(counter, value)) {
+            std::printf(",%.3f", value / static_cast<double>(stats.instancesUpdated));
+        } else {
+            std::printf(",");
+        }
+    }
+    std::printf("\n");
+
+    // Report the allocations of the measured ticks, failing if the library made any
+    if (options.checkAllocations) {
+        const bool failed = allocations > 0 || (target == nullptr && mallocCalls > 0);
+        std::fprintf(stderr, "%s: %lld operator new (%lld of them drawing) and %lld malloc calls in %d ticks "
+                     "after warm-up%s: %s\n", options.name.c_str(), allocations, drawAllocations, mallocCalls,
+                     options.ticks,
+                     target ? " (malloc calls of the GL driver ignored)" : "", failed ? "FAILED" : "ok");
+        return failed ? 1 : 0;
+    }
+    return 0;
+}
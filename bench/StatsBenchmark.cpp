@@ -0,0 +1,87 @@
+#include "AnimationContext.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// This benchmark measures what the statistics counters cost updateAll. It times the serial and the
+// job-based update of a scene mixing marked and plain clips, and prints the counters it collected.
+// Build it twice from the repository root, once as is and once with the counters compiled out, and
+// compare the times of the same variant:
+//   g++ -std=c++17 -O2 -I. bench/StatsBenchmark.cpp *.cpp -lsfml-graphics -lsfml-window -lsfml-system -pthread
+//   g++ -std=c++17 -O2 -DANIMATION_NO_STATS -I. bench/StatsBenchmark.cpp *.cpp -lsfml-graphics -lsfml-window -lsfml-system -pthread
+// Usage: StatsBenchmark [instances] [updates] [workers]
+
+// Function to time updates of a fresh scene (returns milliseconds per update, taking the best of five runs)
+template <typename Update>
+static double timeUpdates(const sf::Texture &texture, int instances, int updates, Update update,
+                          AnimationContext::Stats &stats) {
+    double best = 0.0;
+    for (int run = 0; run < 5; ++run) {
+        // Half the instances change frame on every update and record an event on every frame
+        AnimationContext context;
+        context.addAnimation("marked", texture, {8, 8}, {16, 16}, {0, 0}, 1);
+        for (int frame = 0; frame < 64; ++frame) {
+            context.addAnimationMarker("marked", frame, "step");
+        }
+        context.addAnimation("plain", "marked", {8, 8}, {16, 16}, {0, 0}, 4);
+        for (int instance = 0; instance < instances; ++instance) {
+            context.createInstance(instance % 2 ? "plain" : "marked");
+        }
+        std::vector<AnimationContext::AnimationEvent> events;
+
+        // Warm up so buffers have reached their steady size, then count only the timed updates
+        for (int i = 0; i < 10; ++i) {
+            update(context);
+            context.drainEvents(events);
+        }
+        context.resetStats();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < updates; ++i) {
+            update(context);
+            context.drainEvents(events);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const double perUpdate = elapsed.count() / updates;
+        if (run == 0 || perUpdate < best) {
+            best = perUpdate;
+        }
+        stats = context.getStats();
+    }
+    return best;
+}
+
+// Function to print one variant's time and counters
+static void printVariant(const char *name, double milliseconds, const AnimationContext::Stats &stats) {
+    std::printf("%-12s %12.3f %10lld %14lld %14lld %12lld\n", name, milliseconds, stats.updates,
+                stats.instancesUpdated, stats.framesAdvanced, stats.eventsEmitted);
+}
+
+int main(int argc, char *argv[]) {
+    const int instances = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int updates = argc > 2 ? std::atoi(argv[2]) : 200;
+    AnimationWorkStealingPool pool(argc > 3 ? std::atoi(argv[3]) : 0);
+    const sf::Texture texture;
+
+#ifdef ANIMATION_NO_STATS
+    std::printf("%d instances, %d updates, %d workers, counters compiled out\n", instances, updates,
+                pool.getWorkerCount());
+#else
+    std::printf("%d instances, %d updates, %d workers, counters on\n", instances, updates, pool.getWorkerCount());
+#endif
+    std::printf("%-12s %12s %10s %14s %14s %12s\n", "variant", "ms/update", "updates", "instances", "frames",
+                "events");
+
+    AnimationContext::Stats stats;
+    const double serial = timeUpdates(texture, instances, updates, [](AnimationContext &context) {
+        context.updateAll();
+    }, stats);
+    printVariant("serial", serial, stats);
+
+    const double jobs = timeUpdates(texture, instances, updates, [&](AnimationContext &context) {
+        context.updateAll(pool, 1024);
+    }, stats);
+    printVariant("jobs", jobs, stats);
+    return 0;
+}
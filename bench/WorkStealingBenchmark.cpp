@@ -0,0 +1,110 @@
+#include "AnimationContext.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// This benchmark compares the serial updateAll with the job-based one on a skewed scene, where the
+// first quarter of the active set plays an event-rich clip and the rest a plain looping one.
+// Static partitioning is measured through an AnimationJobSystem adapter that cuts the chunks into one
+// fixed block per worker, and work stealing with a range of grain sizes. Build it from the repository
+// root with, for example:
+//   g++ -std=c++17 -O2 -I. bench/WorkStealingBenchmark.cpp *.cpp -lsfml-graphics -lsfml-window -lsfml-system -pthread
+// Usage: WorkStealingBenchmark [instances] [updates] [workers]
+
+// Job system that splits the indices into one contiguous block per worker, like a fixed thread split.
+// Each block runs as a single job of the pool, so blocks can move between threads but are never divided.
+class StaticPartitionJobs : public AnimationJobSystem {
+public:
+    explicit StaticPartitionJobs(AnimationWorkStealingPool &pool) : m_pool(pool) {}
+
+    void parallelFor(int count, const std::function<void(int)> &job) override {
+        const int workers = m_pool.getWorkerCount();
+        m_pool.parallelFor(workers, [&](int worker) {
+            const int end = static_cast<int>(static_cast<long long>(count) * (worker + 1) / workers);
+            for (int index = static_cast<int>(static_cast<long long>(count) * worker / workers); index < end; ++index) {
+                job(index);
+            }
+        });
+    }
+
+private:
+    AnimationWorkStealingPool &m_pool;
+};
+
+// Function to fill a context with the skewed scene
+static void buildScene(AnimationContext &context, const sf::Texture &texture, int instances) {
+    // A heavy clip that changes frame on every update and records eight events per frame
+    context.addAnimation("heavy", texture, {8, 8}, {16, 16}, {0, 0}, 1);
+    for (int frame = 0; frame < 64; ++frame) {
+        for (int marker = 0; marker < 8; ++marker) {
+            context.addAnimationMarker("heavy", frame, "marker" + std::to_string(marker));
+        }
+    }
+
+    // A light clip that changes frame every eighth update and has no markers
+    context.addAnimation("light", "heavy", {8, 8}, {16, 16}, {0, 0}, 8);
+
+    // Put the heavy instances together at the front of the active set, as a level streamed in at once would
+    for (int instance = 0; instance < instances; ++instance) {
+        context.createInstance(instance < instances / 4 ? "heavy" : "light");
+    }
+}
+
+// Function to time updates of a fresh scene (returns milliseconds per update)
+template <typename Update>
+static double timeUpdates(const sf::Texture &texture, int instances, int updates, Update update) {
+    AnimationContext context;
+    buildScene(context, texture, instances);
+    std::vector<AnimationContext::AnimationEvent> events;
+
+    // Warm up so buffers have reached their steady size
+    for (int i = 0; i < 10; ++i) {
+        update(context);
+        context.drainEvents(events);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < updates; ++i) {
+        update(context);
+        context.drainEvents(events);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / updates;
+}
+
+int main(int argc, char *argv[]) {
+    const int instances = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int updates = argc > 2 ? std::atoi(argv[2]) : 200;
+    AnimationWorkStealingPool pool(argc > 3 ? std::atoi(argv[3]) : 0);
+    const int workers = pool.getWorkerCount();
+    const sf::Texture texture;
+
+    std::printf("%d instances (a quarter of them heavy), %d updates, %d workers\n", instances, updates, workers);
+    std::printf("%-28s %12s %10s %10s\n", "variant", "ms/update", "speedup", "steals");
+
+    // Serial reference
+    const double serial = timeUpdates(texture, instances, updates, [](AnimationContext &context) {
+        context.updateAll();
+    });
+    std::printf("%-28s %12.3f %10.2f %10s\n", "serial", serial, 1.0, "-");
+
+    // Static partitioning: one fixed block of instances per worker
+    StaticPartitionJobs partition(pool);
+    const double partitioned = timeUpdates(texture, instances, updates, [&](AnimationContext &context) {
+        context.updateAll(partition, 256);
+    });
+    std::printf("%-28s %12.3f %10.2f %10s\n", "static partition", partitioned, serial / partitioned, "-");
+
+    // Work stealing over chunks of different sizes
+    for (int grain: {4096, 1024, 256, 64}) {
+        const std::uint64_t steals = pool.getStealCount();
+        const double stealing = timeUpdates(texture, instances, updates, [&](AnimationContext &context) {
+            context.updateAll(pool, grain);
+        });
+        const std::string name = "work stealing, grain " + std::to_string(grain);
+        std::printf("%-28s %12.3f %10.2f %10llu\n", name.c_str(), stealing, serial / stealing,
+                    static_cast<unsigned long long>(pool.getStealCount() - steals));
+    }
+    return 0;
+}
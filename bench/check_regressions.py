@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Run the headless benchmark suite and compare it against a committed baseline.
+
+The suite and its baseline live in one JSON file (bench/baseline.json by default). Every benchmark has
+the arguments passed to HeadlessHarness, the numbers recorded when the baseline was taken and its own
+tolerances:
+  - throughput: fraction the instances updated per second may drop below the baseline (0.10 = 10%)
+  - allocations_per_tick: heap allocations per tick that may be added to the baseline
+  - peak_heap: fraction the peak heap use may grow above the baseline
+The script exits with 1 and prints a table of every benchmark when one of them regresses, with 0 when
+all are within their tolerances, and with 2 when the harness cannot be run. Nothing is downloaded.
+
+Usage:
+  bench/check_regressions.py --harness ./HeadlessHarness            Compare against the baseline
+  bench/check_regressions.py --harness ./HeadlessHarness --update   Record the current numbers as the baseline
+Throughput depends on the machine, so take the baseline on the machine that runs the comparison.
+"""
+
+import argparse
+import csv
+import io
+import json
+import os
+import subprocess
+import sys
+
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "baseline.json")
+DEFAULT_TOLERANCES = {"throughput": 0.10, "allocations_per_tick": 0.0, "peak_heap": 0.10}
+
+
+def run_benchmark(harness, benchmark, repeat):
+    """Run one benchmark and return its best run: the highest throughput and the lowest allocations and heap."""
+    best = None
+    for _ in range(repeat):
+        command = [harness, "--name", benchmark["name"]] + [str(arg) for arg in benchmark["args"]]
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                universal_newlines=True, check=False)
+        if result.returncode != 0:
+            raise RuntimeError("{} failed with exit code {}:\n{}".format(" ".join(command), result.returncode,
+                                                                          result.stderr.strip()))
+        row = next(csv.DictReader(io.StringIO(result.stdout)))
+        measured = {
+            "instances_per_second": float(row["instances_per_second"]),
+            "allocations_per_tick": float(row["allocations_per_tick"]),
+            "peak_heap_bytes": int(row["peak_heap_bytes"]),
+            "p99_us": float(row["p99_us"]),
+        }
+        if best is None:
+            best = measured
+        else:
+            best["instances_per_second"] = max(best["instances_per_second"], measured["instances_per_second"])
+            best["allocations_per_tick"] = min(best["allocations_per_tick"], measured["allocations_per_tick"])
+            best["peak_heap_bytes"] = min(best["peak_heap_bytes"], measured["peak_heap_bytes"])
+            best["p99_us"] = min(best["p99_us"], measured["p99_us"])
+    return best
+
+
+def compare(benchmark, measured):
+    """Return the reasons a benchmark regressed against its baseline, empty if it did not."""
+    baseline = benchmark.get("baseline")
+    if not baseline:
+        return ["no baseline"]
+    tolerances = dict(DEFAULT_TOLERANCES, **benchmark.get("tolerances", {}))
+    reasons = []
+    if measured["instances_per_second"] < baseline["instances_per_second"] * (1.0 - tolerances["throughput"]):
+        reasons.append("throughput")
+    if measured["allocations_per_tick"] > baseline["allocations_per_tick"] + tolerances["allocations_per_tick"]:
+        reasons.append("allocations")
+    if measured["peak_heap_bytes"] > baseline["peak_heap_bytes"] * (1.0 + tolerances["peak_heap"]):
+        reasons.append("peak heap")
+    return reasons
+
+
+def change(current, previous):
+    """Format the relative change from the baseline as a signed percentage."""
+    if not previous:
+        return "n/a" if current else "+0.0%"
+    return "{:+.1f}%".format((current - previous) / previous * 100.0)
+
+
+def print_table(rows):
+    """Print the comparison of every benchmark as an aligned table."""
+    header = ["benchmark", "inst/s base", "inst/s now", "change", "alloc/tick base", "alloc/tick now",
+              "peak heap base", "peak heap now", "change", "status"]
+    widths = [max(len(str(row[column])) for row in [header] + rows) for column in range(len(header))]
+    for index, row in enumerate([header] + rows):
+        print("  ".join(str(cell).ljust(widths[column]) if column == 0 else str(cell).rjust(widths[column])
+                        for column, cell in enumerate(row)))
+        if index == 0:
+            print("  ".join("-" * width for width in widths))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--harness", required=True, help="path of the built HeadlessHarness")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE, help="suite and baseline JSON file")
+    parser.add_argument("--repeat", type=int, default=3, help="runs of each benchmark, the best one counts")
+    parser.add_argument("--only", action="append", help="run only the named benchmark (may be repeated)")
+    parser.add_argument("--update", action="store_true", help="record the current numbers as the baseline")
+    options = parser.parse_args()
+
+    with open(options.baseline) as file:
+        suite = json.load(file)
+    benchmarks = [benchmark for benchmark in suite["benchmarks"]
+                  if not options.only or benchmark["name"] in options.only]
+
+    rows = []
+    regressed = False
+    for benchmark in benchmarks:
+        try:
+            measured = run_benchmark(options.harness, benchmark, max(1, options.repeat))
+        except (OSError, RuntimeError, StopIteration, KeyError, ValueError) as error:
+            print("Cannot run benchmark \"{}\": {}".format(benchmark["name"], error), file=sys.stderr)
+            return 2
+
+        if options.update:
+            benchmark["baseline"] = measured
+            continue
+
+        reasons = compare(benchmark, measured)
+        regressed = regressed or bool(reasons)
+        baseline = benchmark.get("baseline") or {}
+        rows.append([
+            benchmark["name"],
+            "{:.0f}".format(baseline.get("instances_per_second", 0)),
+            "{:.0f}".format(measured["instances_per_second"]),
+            change(measured["instances_per_second"], baseline.get("instances_per_second")),
+            "{:.2f}".format(baseline.get("allocations_per_tick", 0)),
+            "{:.2f}".format(measured["allocations_per_tick"]),
+            baseline.get("peak_heap_bytes", 0),
+            measured["peak_heap_bytes"],
+            change(measured["peak_heap_bytes"], baseline.get("peak_heap_bytes")),
+            "REGRESSED: " + ", ".join(reasons) if reasons else "ok",
+        ])
+
+    if options.update:
+        with open(options.baseline, "w") as file:
+            json.dump(suite, file, indent=2)
+            file.write("\n")
+        print("Recorded the baseline of {} benchmarks in {}".format(len(benchmarks), options.baseline))
+        return 0
+
+    print_table(rows)
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())